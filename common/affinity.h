@@ -0,0 +1,270 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+#include <omp.h>
+#include "memory_policy.h"
+
+// Where the threads of a parallel kernel run.
+//
+//   none      no pinning, the OS migrates threads as it likes
+//   compact   thread t on the t-th CPU in topology order: SMT siblings
+//             first, then the rest of the core's package and node
+//   scatter   one CPU per core before any SMT sibling, round-robin over the
+//             NUMA nodes, so t threads get t cores and all nodes' bandwidth
+//   core      thread t on physical core t (all of its SMT siblings), so no
+//             two threads share a core while there are enough cores
+//   node      thread t on every CPU of node t * nodes / threads: consecutive
+//             threads, which take consecutive row blocks, share a node, and
+//             each may move only within it
+//
+// More threads than places wrap around. Only CPUs in the process's affinity
+// mask at startup are used, so taskset and cgroup limits still apply.
+//
+// std::thread workers are pinned with pin_thread(worker.native_handle(), ...);
+// OpenMP teams with bind_omp_threads(), which pins every team member from
+// inside a parallel region. OMP_PLACES / OMP_PROC_BIND are read when the
+// runtime starts, too early to set from main(), so omp_environment() prints
+// the equivalent settings for launching a run with the runtime's own
+// binding. If OMP_PROC_BIND is already set, bind_omp_threads() leaves the
+// runtime in charge.
+//
+// The mode comes from $AFFINITY (none, compact, scatter, core, node).
+
+enum class Affinity {
+    None,
+    Compact,
+    Scatter,
+    Core,
+    Node
+};
+
+inline const char* affinity_name(Affinity affinity) {
+    switch (affinity) {
+        case Affinity::Compact: return "compact";
+        case Affinity::Scatter: return "scatter";
+        case Affinity::Core: return "core";
+        case Affinity::Node: return "node";
+        default: return "none";
+    }
+}
+
+inline bool parse_affinity(const std::string& name, Affinity& affinity) {
+    for (Affinity a : {Affinity::None, Affinity::Compact, Affinity::Scatter, Affinity::Core, Affinity::Node})
+        if (name == affinity_name(a)) {
+            affinity = a;
+            return true;
+        }
+    return false;
+}
+
+inline Affinity affinity_from_env() {
+    Affinity affinity = Affinity::None;
+    const char* env = std::getenv("AFFINITY");
+    if (env && *env && !parse_affinity(env, affinity))
+        std::fprintf(stderr, "AFFINITY=%s: expected none, compact, scatter, core or node\n", env);
+    return affinity;
+}
+
+struct Cpu {
+    int id;
+    int package;
+    int core;  // core_id, unique only within the package
+    int node;
+};
+
+
+namespace affinity_detail {
+
+inline int read_int(const std::string& path, int fallback) {
+    std::ifstream file(path);
+    int value;
+    return file >> value ? value : fallback;
+}
+
+inline cpu_set_t to_set(const std::vector<int>& cpus) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+        if (cpu >= 0 && cpu < CPU_SETSIZE)
+            CPU_SET(cpu, &set);
+    return set;
+}
+
+// The process mask, captured before anything here pins the calling thread.
+inline const std::vector<int>& allowed_cpus() {
+    static const std::vector<int> cpus = [] {
+        std::vector<int> list;
+        cpu_set_t set;
+        if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+            for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+                if (CPU_ISSET(cpu, &set))
+                    list.push_back(cpu);
+        }
+        if (list.empty())
+            list.push_back(0);
+        return list;
+    }();
+    return cpus;
+}
+
+} // namespace affinity_detail
+
+
+// CPUs this process may run on, in topology order: node, package, core, id.
+inline std::vector<Cpu> cpu_topology() {
+    using namespace affinity_detail;
+    std::map<int, int> node_of;
+    for (int node : numa_nodes()) {
+        std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        std::string list;
+        if (file >> list)
+            for (int cpu : memory_policy_detail::parse_node_list(list))
+                node_of[cpu] = node;
+    }
+
+    std::vector<Cpu> cpus;
+    for (int id : allowed_cpus()) {
+        const std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(id) + "/topology/";
+        Cpu cpu = {id, read_int(dir + "physical_package_id", 0), read_int(dir + "core_id", id), 0};
+        if (node_of.count(id))
+            cpu.node = node_of[id];
+        cpus.push_back(cpu);
+    }
+    std::sort(cpus.begin(), cpus.end(), [](const Cpu& a, const Cpu& b) {
+        if (a.node != b.node) return a.node < b.node;
+        if (a.package != b.package) return a.package < b.package;
+        if (a.core != b.core) return a.core < b.core;
+        return a.id < b.id;
+    });
+    return cpus;
+}
+
+// The CPU set of each of `threads` threads; empty sets for Affinity::None.
+inline std::vector<std::vector<int>> placement(Affinity affinity, int threads) {
+    std::vector<std::vector<int>> sets(threads);
+    if (affinity == Affinity::None || threads <= 0)
+        return sets;
+    const std::vector<Cpu> cpus = cpu_topology();
+
+    // places in the order threads take them, one or more CPUs each
+    std::vector<std::vector<int>> places;
+    if (affinity == Affinity::Compact) {
+        for (const Cpu& cpu : cpus)
+            places.push_back({cpu.id});
+    } else if (affinity == Affinity::Core) {
+        for (std::size_t k = 0; k < cpus.size(); k++) {
+            bool same_core = k > 0 && cpus[k].package == cpus[k - 1].package && cpus[k].core == cpus[k - 1].core;
+            if (same_core)
+                places.back().push_back(cpus[k].id);
+            else
+                places.push_back({cpus[k].id});
+        }
+    } else if (affinity == Affinity::Scatter) {
+        // key: (SMT sibling rank, position among that rank on its node, node)
+        std::vector<std::pair<std::vector<int>, int>> keyed;
+        std::map<std::pair<int, int>, int> taken_on_node;  // (node, rank) -> count
+        for (std::size_t k = 0; k < cpus.size(); k++) {
+            int rank = 0;
+            while (rank < static_cast<int>(k) && cpus[k - rank - 1].package == cpus[k].package &&
+                   cpus[k - rank - 1].core == cpus[k].core)
+                rank++;
+            int position = taken_on_node[{cpus[k].node, rank}]++;
+            keyed.push_back({{rank, position, cpus[k].node}, cpus[k].id});
+        }
+        std::sort(keyed.begin(), keyed.end());
+        for (const auto& entry : keyed)
+            places.push_back({entry.second});
+    } else {
+        std::vector<int> nodes;
+        for (const Cpu& cpu : cpus) {
+            if (nodes.empty() || nodes.back() != cpu.node) {
+                nodes.push_back(cpu.node);
+                places.push_back({});
+            }
+            places.back().push_back(cpu.id);
+        }
+        for (int t = 0; t < threads; t++)
+            sets[t] = places[static_cast<long>(t) * places.size() / threads];
+        return sets;
+    }
+
+    for (int t = 0; t < threads; t++)
+        sets[t] = places[t % places.size()];
+    return sets;
+}
+
+// "0-3,8,10-11"
+inline std::string cpu_list(std::vector<int> cpus) {
+    std::sort(cpus.begin(), cpus.end());
+    std::string text;
+    for (std::size_t k = 0; k < cpus.size();) {
+        std::size_t end = k;
+        while (end + 1 < cpus.size() && cpus[end + 1] == cpus[end] + 1)
+            end++;
+        if (!text.empty())
+            text += ",";
+        text += std::to_string(cpus[k]);
+        if (end > k)
+            text += "-" + std::to_string(cpus[end]);
+        k = end + 1;
+    }
+    return text;
+}
+
+// An empty set means every CPU the process started with.
+inline bool pin_thread(pthread_t thread, const std::vector<int>& cpus) {
+    cpu_set_t set = affinity_detail::to_set(cpus.empty() ? affinity_detail::allowed_cpus() : cpus);
+    return pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+}
+
+inline bool pin_this_thread(const std::vector<int>& cpus) {
+    return pin_thread(pthread_self(), cpus);
+}
+
+// Pins the members of the next `threads`-thread OpenMP team. libgomp keeps
+// its pool threads in the same team positions between regions of the same
+// size, so call this after omp_set_num_threads and before the timed region.
+inline void bind_omp_threads(Affinity affinity, int threads) {
+    if (omp_get_proc_bind() != omp_proc_bind_false)
+        return;
+    const std::vector<std::vector<int>> sets = placement(affinity, threads);
+#pragma omp parallel num_threads(threads)
+    pin_this_thread(sets[omp_get_thread_num()]);
+}
+
+// OMP_PLACES / OMP_PROC_BIND that give the same placement through the
+// OpenMP runtime, for the command line of a run.
+inline std::string omp_environment(Affinity affinity, int threads) {
+    if (affinity == Affinity::None)
+        return "OMP_PROC_BIND=false";
+    std::vector<std::vector<int>> listed;
+    std::string places;
+    for (const std::vector<int>& set : placement(affinity, threads))
+        if (std::find(listed.begin(), listed.end(), set) == listed.end()) {
+            listed.push_back(set);
+            places += (places.empty() ? "{" : ",{") + cpu_list(set) + "}";
+        }
+    return "OMP_PLACES=\"" + places + "\" OMP_PROC_BIND=close";
+}
+
+// The CPU each member of a `threads`-thread team is on right now, in thread
+// order, for recording where a run actually executed.
+inline std::string omp_placement(int threads) {
+    std::vector<int> cpus(threads, -1);
+#pragma omp parallel num_threads(threads)
+    cpus[omp_get_thread_num()] = sched_getcpu();
+    std::string text;
+    for (int cpu : cpus)
+        text += (text.empty() ? "" : " ") + std::to_string(cpu);
+    return text;
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <omp.h>
+
+// Picks the OpenMP schedule kind, chunk size and thread count per kernel and
+// problem size, and remembers the winners in a text file so later runs start
+// on them without sweeping. Kernels opt in by using schedule(runtime) and
+// no num_threads clause; apply() sets both.
+//
+//   Autotuner tuner;                                  // loads tuning.txt
+//   TuneConfig best = tuner.tune("gemv", n, [&] { kernel(); });
+//   Autotuner::apply(best);
+//
+// The file is $TUNING_FILE or ./tuning.txt, one line per entry:
+//
+//   <kernel> <size> <static|dynamic|guided> <chunk> <threads> <seconds>
+//
+// The search is coordinate-wise rather than the full grid: thread counts
+// with the default static schedule, then every kind and chunk at the best
+// count, then the thread counts again with the best schedule. Each
+// candidate runs once to warm up and is timed by the best of `repeats` runs.
+
+struct TuneConfig {
+    omp_sched_t kind = omp_sched_static;
+    int chunk = 0;  // 0: the schedule's default
+    int threads = 1;
+    double seconds = 0.0;
+};
+
+inline const char* schedule_name(omp_sched_t kind) {
+    switch (kind) {
+        case omp_sched_dynamic: return "dynamic";
+        case omp_sched_guided: return "guided";
+        default: return "static";
+    }
+}
+
+inline bool parse_schedule(const std::string& name, omp_sched_t& kind) {
+    for (omp_sched_t k : {omp_sched_static, omp_sched_dynamic, omp_sched_guided})
+        if (name == schedule_name(k)) {
+            kind = k;
+            return true;
+        }
+    return false;
+}
+
+class Autotuner {
+public:
+    explicit Autotuner(std::string path = default_path(), int repeats = 3) : path_(std::move(path)), repeats_(repeats) {
+        load();
+    }
+
+    static std::string default_path() {
+        const char* env = std::getenv("TUNING_FILE");
+        return env && *env ? env : "tuning.txt";
+    }
+
+    const std::string& path() const { return path_; }
+
+    bool lookup(const std::string& kernel, long size, TuneConfig& config) const {
+        auto it = table_.find({kernel, size});
+        if (it == table_.end())
+            return false;
+        config = it->second;
+        return true;
+    }
+
+    static void apply(const TuneConfig& config) {
+        omp_set_schedule(config.kind, config.chunk);
+        omp_set_num_threads(config.threads);
+    }
+
+    // The stored configuration, or a new search over `run` whose winner is
+    // stored and saved. `run` must do one complete kernel invocation.
+    template <typename F>
+    TuneConfig tune(const std::string& kernel, long size, F run) {
+        TuneConfig best;
+        if (lookup(kernel, size, best))
+            return best;
+
+        best.threads = 1;
+        best.seconds = measure(best, run);
+        for (int t : thread_counts())
+            try_config({omp_sched_static, 0, t, 0.0}, best, run);
+
+        const TuneConfig threads_winner = best;
+        for (omp_sched_t kind : {omp_sched_static, omp_sched_dynamic, omp_sched_guided})
+            for (int chunk : {0, 1, 16, 64, 256})
+                try_config({kind, chunk, threads_winner.threads, 0.0}, best, run);
+
+        for (int t : thread_counts())
+            try_config({best.kind, best.chunk, t, 0.0}, best, run);
+
+        table_[{kernel, size}] = best;
+        save();
+        return best;
+    }
+
+    void save() const {
+        std::ofstream file(path_);
+        for (const auto& entry : table_) {
+            const TuneConfig& c = entry.second;
+            file << entry.first.first << " " << entry.first.second << " " << schedule_name(c.kind) << " " << c.chunk
+                 << " " << c.threads << " " << c.seconds << "\n";
+        }
+        if (!file)
+            std::cerr << "Autotuner: cannot write " << path_ << std::endl;
+    }
+
+    // 1, 2, 4, ... up to the number of processors, which is always included
+    static std::vector<int> thread_counts() {
+        std::vector<int> counts;
+        int procs = omp_get_num_procs();
+        for (int t = 1; t < procs; t *= 2)
+            counts.push_back(t);
+        counts.push_back(procs);
+        return counts;
+    }
+
+private:
+    void load() {
+        std::ifstream file(path_);
+        std::string kernel, kind_name;
+        long size;
+        TuneConfig c;
+        while (file >> kernel >> size >> kind_name >> c.chunk >> c.threads >> c.seconds)
+            if (parse_schedule(kind_name, c.kind) && c.threads > 0)
+                table_[{kernel, size}] = c;
+    }
+
+    template <typename F>
+    double measure(const TuneConfig& config, F& run) const {
+        apply(config);
+        run();
+        double best = 1e30;
+        for (int r = 0; r < repeats_; r++) {
+            auto start_time = std::chrono::high_resolution_clock::now();
+            run();
+            auto end_time = std::chrono::high_resolution_clock::now();
+            best = std::min(best, std::chrono::duration<double>(end_time - start_time).count());
+        }
+        return best;
+    }
+
+    template <typename F>
+    void try_config(TuneConfig candidate, TuneConfig& best, F& run) const {
+        if (candidate.kind == best.kind && candidate.chunk == best.chunk && candidate.threads == best.threads)
+            return;
+        candidate.seconds = measure(candidate, run);
+        if (candidate.seconds < best.seconds)
+            best = candidate;
+    }
+
+    std::string path_;
+    int repeats_;
+    std::map<std::pair<std::string, long>, TuneConfig> table_;
+};
@@ -0,0 +1,300 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Repeated timing with summary statistics, for the thread/size sweeps of the
+// lab drivers.
+//
+//   Sweep sweep("lab2/2");
+//   for (int threads : {1, 2, 4}) {
+//       omp_set_num_threads(threads);
+//       sweep.run("integrate", nsteps, threads, [&] { integrate(nsteps); });
+//   }
+//   sweep.print_summary();
+//   sweep.save();
+//
+// measure() does `warmup` untimed runs, then times runs until the 95%
+// confidence interval of the mean is within `ci` (relative) of the mean, or
+// `max_runs` runs or `max_seconds` have been spent, but never fewer than
+// `min_runs`. Reported times are seconds; speedups use medians, which one
+// slow run does not move.
+//
+// annotate() gives the flops and bytes of one run to the records that
+// follow, which adds GFLOP/s and GB/s to their output (and is what
+// roofline.h needs).
+//
+// A probe (perf_counters.h has them) is started before and stopped after
+// every timed run, and its metrics(runs) are stored with the record; those
+// named name[t] (per thread) are saved but left off the printed line.
+//
+// Speedup of a record is the median of the 1-thread record of the same
+// kernel and size over its own median (the fewest threads measured if there
+// is no 1-thread run), efficiency is speedup per thread relative to that
+// baseline.
+//
+// Environment:
+//   BENCH_WARMUP, BENCH_MIN_RUNS, BENCH_MAX_RUNS, BENCH_CI, BENCH_MAX_SECONDS
+//                override the defaults below
+//   BENCH_OUTPUT file for save(): JSON if it ends in .json, otherwise CSV
+
+struct BenchOptions {
+    int warmup = 1;
+    int min_runs = 3;
+    int max_runs = 30;
+    double ci = 0.02;
+    double max_seconds = 10.0;
+
+    static BenchOptions from_env() {
+        BenchOptions options;
+        auto read = [](const char* name, double value) {
+            const char* env = std::getenv(name);
+            return env && *env ? std::atof(env) : value;
+        };
+        options.warmup = static_cast<int>(read("BENCH_WARMUP", options.warmup));
+        options.min_runs = std::max(1, static_cast<int>(read("BENCH_MIN_RUNS", options.min_runs)));
+        options.max_runs = std::max(options.min_runs, static_cast<int>(read("BENCH_MAX_RUNS", options.max_runs)));
+        options.ci = read("BENCH_CI", options.ci);
+        options.max_seconds = read("BENCH_MAX_SECONDS", options.max_seconds);
+        return options;
+    }
+};
+
+struct Stats {
+    int runs = 0;
+    double median = 0.0, min = 0.0, mean = 0.0, stddev = 0.0;
+    double ci = 0.0;  // half-width of the 95% confidence interval of the mean
+};
+
+
+namespace bench_detail {
+
+// two-sided 95% Student t quantiles for 1..30 degrees of freedom
+inline double t95(int df) {
+    static const double table[30] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                                     2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                                     2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+    return df < 1 ? 0.0 : df <= 30 ? table[df - 1] : 1.960;
+}
+
+inline std::string escape_json(const std::string& text) {
+    std::string out;
+    for (char c : text) {
+        if (c == '"' || c == '\\')
+            out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+} // namespace bench_detail
+
+
+inline Stats summarize(std::vector<double> times) {
+    Stats s;
+    s.runs = static_cast<int>(times.size());
+    if (times.empty())
+        return s;
+    std::sort(times.begin(), times.end());
+    const std::size_t n = times.size();
+    s.min = times[0];
+    s.median = n % 2 ? times[n / 2] : 0.5 * (times[n / 2 - 1] + times[n / 2]);
+    for (double t : times)
+        s.mean += t;
+    s.mean /= n;
+    if (n > 1) {
+        double sq = 0.0;
+        for (double t : times)
+            sq += (t - s.mean) * (t - s.mean);
+        s.stddev = std::sqrt(sq / (n - 1));
+        s.ci = bench_detail::t95(static_cast<int>(n) - 1) * s.stddev / std::sqrt(static_cast<double>(n));
+    }
+    return s;
+}
+
+// The default probe: records nothing.
+struct NoProbe {
+    void start() {}
+    void stop() {}
+    std::vector<std::pair<std::string, double>> metrics(int) const { return {}; }
+};
+
+// `run` must do one complete, self-contained invocation of the kernel.
+template <typename F, typename P = NoProbe>
+Stats measure(F&& run, const BenchOptions& options = BenchOptions::from_env(), P&& probe = P()) {
+    for (int w = 0; w < options.warmup; w++)
+        run();
+    std::vector<double> times;
+    double spent = 0.0;
+    while (static_cast<int>(times.size()) < options.max_runs) {
+        probe.start();
+        auto start_time = std::chrono::high_resolution_clock::now();
+        run();
+        auto end_time = std::chrono::high_resolution_clock::now();
+        probe.stop();
+        times.push_back(std::chrono::duration<double>(end_time - start_time).count());
+        spent += times.back();
+        if (static_cast<int>(times.size()) < options.min_runs)
+            continue;
+        Stats s = summarize(times);
+        if (s.ci <= options.ci * s.mean || spent >= options.max_seconds)
+            break;
+    }
+    return summarize(times);
+}
+
+
+struct BenchRecord {
+    std::string kernel;
+    long size = 0;
+    int threads = 1;
+    std::string placement;  // CPUs the threads ran on, if the driver records it
+    Stats stats;
+    double speedup = 1.0, efficiency = 1.0;
+    std::vector<std::pair<std::string, double>> metrics;  // per run, from the probe
+    double flops = 0.0, bytes = 0.0;  // per run, from annotate()
+};
+
+class Sweep {
+public:
+    explicit Sweep(std::string name, BenchOptions options = BenchOptions::from_env())
+        : name_(std::move(name)), options_(options) {}
+
+    const BenchOptions& options() const { return options_; }
+    const std::vector<BenchRecord>& records() const { return records_; }
+
+    // Work of one run of the kernel measured next, until changed.
+    void annotate(double flops, double bytes) {
+        flops_ = flops;
+        bytes_ = bytes;
+    }
+
+    // Measures `body`, stores the record and prints its line.
+    template <typename F, typename P = NoProbe>
+    const BenchRecord& run(const std::string& kernel, long size, int threads, F&& body,
+                           const std::string& placement = "", P&& probe = P()) {
+        BenchRecord record;
+        record.kernel = kernel;
+        record.size = size;
+        record.threads = threads;
+        record.placement = placement;
+        record.flops = flops_;
+        record.bytes = bytes_;
+        record.stats = measure(body, options_, probe);
+        record.metrics = probe.metrics(record.stats.runs);
+        return add(record);
+    }
+
+    // For records completed after measuring, e.g. with the CPUs the runs used.
+    const BenchRecord& add(BenchRecord record) {
+        records_.push_back(record);
+        update_speedups();
+        const BenchRecord& r = records_.back();
+        std::cout << r.kernel << ", size " << r.size << ", " << r.threads << " threads: median " << r.stats.median
+                  << " s (min " << r.stats.min << ", stddev " << r.stats.stddev << ", +-" << r.stats.ci << ", "
+                  << r.stats.runs << " runs), S = " << r.speedup << ", E = " << r.efficiency;
+        if (r.flops > 0.0 && r.stats.median > 0.0)
+            std::cout << ", " << r.flops / r.stats.median / 1e9 << " GFLOP/s, " << r.bytes / r.stats.median / 1e9 << " GB/s";
+        if (!r.placement.empty())
+            std::cout << ", CPUs " << r.placement;
+        // per-thread metrics, name[t], only go to the saved records
+        for (const auto& m : r.metrics)
+            if (m.first.find('[') == std::string::npos)
+                std::cout << ", " << m.first << " " << m.second;
+        std::cout << std::endl;
+        return r;
+    }
+
+    void print_summary(std::ostream& out = std::cout) const {
+        out << std::endl << "Summary (" << name_ << "):" << std::endl;
+        out << "| kernel | size | threads | median, s | min, s | stddev, s | 95% CI, s | runs | speedup | efficiency |" << std::endl;
+        out << "|--------|------|---------|-----------|--------|-----------|-----------|------|---------|------------|" << std::endl;
+        for (const BenchRecord& r : records_)
+            out << "| " << r.kernel << " | " << r.size << " | " << r.threads << " | " << r.stats.median << " | "
+                << r.stats.min << " | " << r.stats.stddev << " | " << r.stats.ci << " | " << r.stats.runs << " | "
+                << r.speedup << " | " << r.efficiency << " |" << std::endl;
+    }
+
+    // One column per metric name seen in any record, empty where missing.
+    void write_csv(std::ostream& out) const {
+        std::vector<std::string> names;
+        for (const BenchRecord& r : records_)
+            for (const auto& m : r.metrics)
+                if (std::find(names.begin(), names.end(), m.first) == names.end())
+                    names.push_back(m.first);
+        out << "bench,kernel,size,threads,runs,median,min,mean,stddev,ci95,speedup,efficiency,flops,bytes,placement";
+        for (const std::string& name : names)
+            out << "," << name;
+        out << "\n";
+        for (const BenchRecord& r : records_) {
+            out << name_ << ",\"" << r.kernel << "\"," << r.size << "," << r.threads << "," << r.stats.runs << ","
+                << r.stats.median << "," << r.stats.min << "," << r.stats.mean << "," << r.stats.stddev << ","
+                << r.stats.ci << "," << r.speedup << "," << r.efficiency << "," << r.flops << "," << r.bytes << ",\""
+                << r.placement << "\"";
+            for (const std::string& name : names) {
+                out << ",";
+                for (const auto& m : r.metrics)
+                    if (m.first == name)
+                        out << m.second;
+            }
+            out << "\n";
+        }
+    }
+
+    void write_json(std::ostream& out) const {
+        using bench_detail::escape_json;
+        out << "{\"bench\": \"" << escape_json(name_) << "\", \"records\": [";
+        for (std::size_t k = 0; k < records_.size(); k++) {
+            const BenchRecord& r = records_[k];
+            out << (k ? ",\n  " : "\n  ") << "{\"kernel\": \"" << escape_json(r.kernel) << "\", \"size\": " << r.size
+                << ", \"threads\": " << r.threads << ", \"runs\": " << r.stats.runs << ", \"median\": " << r.stats.median
+                << ", \"min\": " << r.stats.min << ", \"mean\": " << r.stats.mean << ", \"stddev\": " << r.stats.stddev
+                << ", \"ci95\": " << r.stats.ci << ", \"speedup\": " << r.speedup << ", \"efficiency\": " << r.efficiency
+                << ", \"flops\": " << r.flops << ", \"bytes\": " << r.bytes
+                << ", \"placement\": \"" << escape_json(r.placement) << "\", \"metrics\": {";
+            for (std::size_t m = 0; m < r.metrics.size(); m++)
+                out << (m ? ", \"" : "\"") << escape_json(r.metrics[m].first) << "\": " << r.metrics[m].second;
+            out << "}}";
+        }
+        out << "\n]}\n";
+    }
+
+    // Writes to `path`, or $BENCH_OUTPUT, or nowhere if neither is set.
+    void save(std::string path = "") const {
+        if (path.empty()) {
+            const char* env = std::getenv("BENCH_OUTPUT");
+            path = env ? env : "";
+        }
+        if (path.empty())
+            return;
+        std::ofstream file(path);
+        bool json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+        json ? write_json(file) : write_csv(file);
+        if (!file)
+            std::cerr << "Sweep: cannot write " << path << std::endl;
+    }
+
+private:
+    void update_speedups() {
+        for (BenchRecord& r : records_) {
+            const BenchRecord* base = nullptr;
+            for (const BenchRecord& b : records_)
+                if (b.kernel == r.kernel && b.size == r.size && (!base || b.threads < base->threads))
+                    base = &b;
+            r.speedup = r.stats.median > 0.0 ? base->stats.median / r.stats.median : 0.0;
+            r.efficiency = r.speedup * base->threads / r.threads;
+        }
+    }
+
+    std::string name_;
+    BenchOptions options_;
+    std::vector<BenchRecord> records_;
+    double flops_ = 0.0, bytes_ = 0.0;
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+// Storage-only bfloat16: the upper 16 bits of an IEEE float. Arithmetic is
+// done after widening to float; narrowing rounds to nearest even.
+struct bfloat16 {
+    uint16_t bits;
+
+    bfloat16() = default;
+
+    bfloat16(float value) {
+        uint32_t u;
+        std::memcpy(&u, &value, sizeof(u));
+        if ((u & 0x7fffffffu) > 0x7f800000u)
+            bits = static_cast<uint16_t>((u >> 16) | 0x40);  // keep NaN quiet
+        else
+            bits = static_cast<uint16_t>((u + 0x7fffu + ((u >> 16) & 1)) >> 16);
+    }
+
+    operator float() const {
+        uint32_t u = static_cast<uint32_t>(bits) << 16;
+        float value;
+        std::memcpy(&value, &u, sizeof(value));
+        return value;
+    }
+};
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <utility>
+#include "memory_policy.h"
+
+// Dense row-major matrix in one 64-byte-aligned allocation. Every row starts
+// on a cache line: the leading dimension is the column count rounded up to
+// a whole number of cache lines, plus one extra line when a row would be a
+// multiple of 4 KiB (rows that far apart alias in L1 and in the prefetcher).
+//
+// The constructor without a value does not touch the memory, so the first
+// parallel loop that writes it decides page placement; fill it with the same
+// row split the compute kernel uses. A MemoryPolicy (memory_policy.h) can
+// instead interleave the pages, bind them to a node or back them with huge
+// pages.
+
+const std::size_t CACHE_LINE = 64;
+
+
+// Contiguous run of elements, e.g. one row.
+template <typename T>
+struct Span {
+    T* ptr;
+    std::size_t count;
+
+    T& operator[](std::size_t i) const { return ptr[i]; }
+    std::size_t size() const { return count; }
+    T* data() const { return ptr; }
+    T* begin() const { return ptr; }
+    T* end() const { return ptr + count; }
+};
+
+// Elements `stride` apart, e.g. one column.
+template <typename T>
+struct StridedSpan {
+    T* ptr;
+    std::size_t count;
+    std::size_t stride;
+
+    T& operator[](std::size_t i) const { return ptr[i * stride]; }
+    std::size_t size() const { return count; }
+};
+
+// Non-owning rows x cols window with leading dimension ld; what block()
+// and Matrix::view() return.
+template <typename T>
+struct MatrixView {
+    T* ptr;
+    std::size_t rows, cols, ld;
+
+    T& operator()(std::size_t i, std::size_t j) const { return ptr[i * ld + j]; }
+    Span<T> row(std::size_t i) const { return {ptr + i * ld, cols}; }
+    StridedSpan<T> col(std::size_t j) const { return {ptr + j, rows, ld}; }
+
+    MatrixView block(std::size_t i, std::size_t j, std::size_t r, std::size_t c) const {
+        return {ptr + i * ld + j, r, c, ld};
+    }
+};
+
+
+template <typename T>
+class Matrix {
+public:
+    Matrix() = default;
+
+    Matrix(std::size_t rows, std::size_t cols, const MemoryPolicy& policy = MemoryPolicy())
+        : rows_(rows), cols_(cols), ld_(leading_dimension(cols)), policy_(policy) {
+        data_ = static_cast<T*>(allocate_pages(bytes(), policy_, CACHE_LINE));
+    }
+
+    Matrix(std::size_t rows, std::size_t cols, const T& value) : Matrix(rows, cols) {
+        for (std::size_t i = 0; i < rows_; i++)
+            for (std::size_t j = 0; j < cols_; j++)
+                (*this)(i, j) = value;
+    }
+
+    Matrix(const Matrix& other) : Matrix(other.rows_, other.cols_, other.policy_) {
+        std::memcpy(data_, other.data_, rows_ * ld_ * sizeof(T));
+    }
+
+    Matrix(Matrix&& other) noexcept
+        : data_(std::exchange(other.data_, nullptr)), rows_(other.rows_), cols_(other.cols_), ld_(other.ld_),
+          policy_(other.policy_) {}
+
+    Matrix& operator=(Matrix other) noexcept {
+        std::swap(data_, other.data_);
+        std::swap(rows_, other.rows_);
+        std::swap(cols_, other.cols_);
+        std::swap(ld_, other.ld_);
+        std::swap(policy_, other.policy_);
+        return *this;
+    }
+
+    ~Matrix() { release_pages(data_, bytes(), policy_); }
+
+    std::size_t rows() const { return rows_; }
+    std::size_t cols() const { return cols_; }
+    std::size_t ld() const { return ld_; }
+    std::size_t bytes() const { return rows_ * ld_ * sizeof(T); }
+    const MemoryPolicy& policy() const { return policy_; }
+    T* data() { return data_; }
+    const T* data() const { return data_; }
+
+    T& operator()(std::size_t i, std::size_t j) { return data_[i * ld_ + j]; }
+    const T& operator()(std::size_t i, std::size_t j) const { return data_[i * ld_ + j]; }
+
+    Span<T> row(std::size_t i) { return {data_ + i * ld_, cols_}; }
+    Span<const T> row(std::size_t i) const { return {data_ + i * ld_, cols_}; }
+    StridedSpan<T> col(std::size_t j) { return {data_ + j, rows_, ld_}; }
+    StridedSpan<const T> col(std::size_t j) const { return {data_ + j, rows_, ld_}; }
+
+    MatrixView<T> view() { return {data_, rows_, cols_, ld_}; }
+    MatrixView<const T> view() const { return {data_, rows_, cols_, ld_}; }
+
+    static std::size_t leading_dimension(std::size_t cols) {
+        const std::size_t per_line = CACHE_LINE / sizeof(T);
+        std::size_t ld = (cols + per_line - 1) / per_line * per_line;
+        if (ld * sizeof(T) % 4096 == 0)
+            ld += per_line;
+        return ld;
+    }
+
+private:
+    T* data_ = nullptr;
+    std::size_t rows_ = 0, cols_ = 0, ld_ = 0;
+    MemoryPolicy policy_;
+};
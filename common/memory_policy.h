@@ -0,0 +1,191 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <string>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Where the pages of a large allocation go on a NUMA machine.
+//
+//   first_touch   the default: no policy, each page lands on the node of the
+//                 thread that writes it first, so initialize with the same
+//                 row split the compute kernel uses
+//   interleave    pages round-robin over all online nodes; bandwidth of every
+//                 node, no locality, for data that all threads read
+//   on_node(n)    every page on node n
+//
+// Independently, huge_pages aligns the mapping to 2 MiB and asks for
+// transparent huge pages with madvise, which cuts TLB misses when streaming
+// large matrices.
+//
+// The NUMA calls are made through syscall(), so nothing needs libnuma.
+// Policies are hints: on a kernel or container without NUMA support mbind
+// fails and the memory is simply first-touch.
+
+enum class Placement {
+    FirstTouch,
+    Interleave,
+    Node
+};
+
+struct MemoryPolicy {
+    Placement placement = Placement::FirstTouch;
+    int node = 0;
+    bool huge_pages = false;
+
+    static MemoryPolicy first_touch(bool huge_pages = false) { return {Placement::FirstTouch, 0, huge_pages}; }
+    static MemoryPolicy interleave(bool huge_pages = false) { return {Placement::Interleave, 0, huge_pages}; }
+    static MemoryPolicy on_node(int node, bool huge_pages = false) { return {Placement::Node, node, huge_pages}; }
+
+    // plain aligned_alloc is enough, nothing to mmap or mbind
+    bool is_default() const { return placement == Placement::FirstTouch && !huge_pages; }
+};
+
+const std::size_t HUGE_PAGE = 2 << 20;
+
+
+namespace memory_policy_detail {
+
+// from <numaif.h>
+const int MPOL_BIND_ = 2;
+const int MPOL_INTERLEAVE_ = 3;
+const int MPOL_MF_MOVE_ = 1 << 1;
+
+inline std::vector<int> parse_node_list(const std::string& list) {
+    std::vector<int> nodes;
+    std::size_t pos = 0;
+    while (pos < list.size()) {
+        std::size_t end = list.find(',', pos);
+        if (end == std::string::npos)
+            end = list.size();
+        std::string item = list.substr(pos, end - pos);
+        std::size_t dash = item.find('-');
+        if (!item.empty()) {
+            int first = std::atoi(item.c_str());
+            int last = dash == std::string::npos ? first : std::atoi(item.c_str() + dash + 1);
+            for (int n = first; n <= last; n++)
+                nodes.push_back(n);
+        }
+        pos = end + 1;
+    }
+    return nodes;
+}
+
+inline long mbind(void* ptr, std::size_t bytes, int mode, const std::vector<unsigned long>& mask) {
+    return syscall(SYS_mbind, ptr, bytes, mode, mask.data(), mask.size() * 8 * sizeof(unsigned long), MPOL_MF_MOVE_);
+}
+
+} // namespace memory_policy_detail
+
+
+// Online NUMA nodes, {0} when the machine does not expose any.
+inline std::vector<int> numa_nodes() {
+    std::ifstream file("/sys/devices/system/node/online");
+    std::string list;
+    if (!(file >> list))
+        return {0};
+    std::vector<int> nodes = memory_policy_detail::parse_node_list(list);
+    return nodes.empty() ? std::vector<int>{0} : nodes;
+}
+
+// Node of the CPU the calling thread runs on.
+inline int current_node() {
+    unsigned cpu = 0, node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0)
+        return 0;
+    return static_cast<int>(node);
+}
+
+// Node of each page in [ptr, ptr + bytes), -1 for pages not yet touched.
+inline std::vector<int> page_nodes(const void* ptr, std::size_t bytes) {
+    const std::size_t page = sysconf(_SC_PAGESIZE);
+    const std::uintptr_t first = reinterpret_cast<std::uintptr_t>(ptr) / page * page;
+    const std::size_t count = (reinterpret_cast<std::uintptr_t>(ptr) + bytes - first + page - 1) / page;
+    std::vector<void*> pages(count);
+    for (std::size_t k = 0; k < count; k++)
+        pages[k] = reinterpret_cast<void*>(first + k * page);
+    std::vector<int> status(count, -1);
+    if (syscall(SYS_move_pages, 0, count, pages.data(), nullptr, status.data(), 0) != 0)
+        return std::vector<int>(count, -1);
+    for (int& s : status)
+        if (s < 0)
+            s = -1;
+    return status;
+}
+
+// `bytes` rounded up to whole pages (huge pages if requested), placed
+// according to `policy`. Release with release_pages using the same size
+// and policy.
+inline void* allocate_pages(std::size_t bytes, const MemoryPolicy& policy, std::size_t alignment) {
+    using namespace memory_policy_detail;
+    if (bytes == 0)
+        bytes = alignment;
+    if (policy.is_default()) {
+        void* ptr = std::aligned_alloc(alignment, (bytes + alignment - 1) / alignment * alignment);
+        if (!ptr)
+            throw std::bad_alloc();
+        return ptr;
+    }
+
+    const std::size_t page = policy.huge_pages ? HUGE_PAGE : sysconf(_SC_PAGESIZE);
+    const std::size_t length = (bytes + page - 1) / page * page;
+    // map one extra huge page and trim, mmap only guarantees 4 KiB alignment
+    const std::size_t slack = policy.huge_pages ? HUGE_PAGE : 0;
+    void* raw = mmap(nullptr, length + slack, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED)
+        throw std::bad_alloc();
+    char* start = static_cast<char*>(raw);
+    if (slack > 0) {
+        char* aligned = reinterpret_cast<char*>((reinterpret_cast<std::uintptr_t>(start) + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE);
+        if (aligned > start)
+            munmap(start, aligned - start);
+        if (aligned + length < start + length + slack)
+            munmap(aligned + length, start + length + slack - (aligned + length));
+        start = aligned;
+        madvise(start, length, MADV_HUGEPAGE);
+    }
+
+    if (policy.placement != Placement::FirstTouch) {
+        std::vector<int> nodes = policy.placement == Placement::Node ? std::vector<int>{policy.node} : numa_nodes();
+        std::vector<unsigned long> mask(1);
+        for (int n : nodes) {
+            std::size_t word = n / (8 * sizeof(unsigned long));
+            if (word >= mask.size())
+                mask.resize(word + 1);
+            mask[word] |= 1ul << (n % (8 * sizeof(unsigned long)));
+        }
+        int mode = policy.placement == Placement::Node ? MPOL_BIND_ : MPOL_INTERLEAVE_;
+        mbind(start, length, mode, mask);  // a hint, see above
+    }
+    return start;
+}
+
+inline void release_pages(void* ptr, std::size_t bytes, const MemoryPolicy& policy) {
+    if (!ptr)
+        return;
+    if (policy.is_default()) {
+        std::free(ptr);
+        return;
+    }
+    const std::size_t page = policy.huge_pages ? HUGE_PAGE : sysconf(_SC_PAGESIZE);
+    munmap(ptr, ((bytes > 0 ? bytes : 1) + page - 1) / page * page);
+}
+
+// AnonHugePages of this process in kB, from /proc/self/smaps_rollup.
+inline long huge_page_kb() {
+    std::ifstream file("/proc/self/smaps_rollup");
+    std::string key;
+    long value;
+    while (file >> key) {
+        if (key == "AnonHugePages:" && file >> value)
+            return value;
+        file.ignore(1 << 10, '\n');
+    }
+    return 0;
+}
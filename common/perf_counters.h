@@ -0,0 +1,245 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Per-thread event counts from perf_event_open, for telling compute-bound
+// kernels (high IPC, few LLC misses) from memory-bound ones (stalled cycles,
+// LLC misses per row).
+//
+//   TeamCounters counters(threads);          // after omp_set_num_threads
+//   sweep.run("gemv", n, threads, [&] { kernel(); }, placement, counters);
+//
+// Hardware events count user-space work only (exclude_kernel), which is
+// what perf_event_paranoid <= 2 allows without privileges; software events
+// are counted in the kernel, where they happen. An event that
+// cannot be opened (no PMU in a VM or container, a stricter paranoid
+// setting, stalled cycles on CPUs that do not expose them) reads as
+// unavailable and is left out of the metrics; the software events
+// (task clock, context switches, migrations) are nearly always there, so
+// a run without hardware counters still records CPU time and scheduling
+// noise. When the kernel multiplexes events, counts are scaled by
+// enabled / running time.
+
+enum class Counter {
+    Cycles,
+    Instructions,
+    LlcMisses,
+    BranchMisses,
+    StalledCycles,    // backend
+    TaskClock,        // ns of CPU time
+    ContextSwitches,
+    Migrations
+};
+
+const int COUNTERS = 8;
+
+inline const char* counter_name(Counter counter) {
+    static const char* names[COUNTERS] = {"cycles", "instructions", "llc_misses", "branch_misses",
+                                          "stalled_cycles", "task_clock_ns", "context_switches", "cpu_migrations"};
+    return names[static_cast<int>(counter)];
+}
+
+// One count per counter, negative where the event is unavailable.
+struct CounterValues {
+    double value[COUNTERS];
+
+    CounterValues() { std::fill(value, value + COUNTERS, -1.0); }
+
+    bool available(Counter c) const { return value[static_cast<int>(c)] >= 0.0; }
+    double operator[](Counter c) const { return value[static_cast<int>(c)]; }
+
+    CounterValues& operator+=(const CounterValues& other) {
+        for (int k = 0; k < COUNTERS; k++)
+            value[k] = value[k] < 0.0 || other.value[k] < 0.0 ? -1.0 : value[k] + other.value[k];
+        return *this;
+    }
+};
+
+
+namespace perf_counters_detail {
+
+inline void set_event(perf_event_attr& attr, Counter counter) {
+    static const std::uint64_t configs[COUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_STALLED_CYCLES_BACKEND,
+        PERF_COUNT_SW_TASK_CLOCK, PERF_COUNT_SW_CONTEXT_SWITCHES, PERF_COUNT_SW_CPU_MIGRATIONS};
+    attr.type = counter >= Counter::TaskClock ? PERF_TYPE_SOFTWARE : PERF_TYPE_HARDWARE;
+    attr.config = configs[static_cast<int>(counter)];
+}
+
+inline int open_event(Counter counter, pid_t tid, bool inherit) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    set_event(attr, counter);
+    attr.disabled = 1;
+    attr.inherit = inherit;
+    // software events happen in the kernel (a context switch is counted in
+    // the scheduler), so excluding it would leave them at zero
+    if (attr.type == PERF_TYPE_HARDWARE) {
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+    }
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, tid, -1, -1, PERF_FLAG_FD_CLOEXEC));
+}
+
+inline void warn_unavailable() {
+    static bool warned = false;
+    if (!warned)
+        std::fprintf(stderr, "perf counters: hardware events unavailable (no PMU or perf_event_paranoid), "
+                             "recording software events only\n");
+    warned = true;
+}
+
+} // namespace perf_counters_detail
+
+
+// The counters of one thread, opened disabled. tid 0 is the calling thread;
+// with `inherit`, threads it creates afterwards are counted too, their counts
+// added when they exit (std::thread workers spawned per run).
+class PerfCounters {
+public:
+    explicit PerfCounters(pid_t tid = 0, bool inherit = false) {
+        for (int k = 0; k < COUNTERS; k++)
+            fd_[k] = perf_counters_detail::open_event(static_cast<Counter>(k), tid, inherit);
+        if (fd_[static_cast<int>(Counter::Cycles)] < 0)
+            perf_counters_detail::warn_unavailable();
+    }
+
+    ~PerfCounters() {
+        for (int fd : fd_)
+            if (fd >= 0)
+                close(fd);
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    PerfCounters(PerfCounters&& other) noexcept {
+        std::copy(other.fd_, other.fd_ + COUNTERS, fd_);
+        std::fill(other.fd_, other.fd_ + COUNTERS, -1);
+    }
+
+    void start() { control(PERF_EVENT_IOC_ENABLE); }
+    void stop() { control(PERF_EVENT_IOC_DISABLE); }
+    void reset() { control(PERF_EVENT_IOC_RESET); }
+
+    CounterValues read_values() const {
+        CounterValues values;
+        for (int k = 0; k < COUNTERS; k++) {
+            std::uint64_t data[3];  // value, time enabled, time running
+            if (fd_[k] < 0 || ::read(fd_[k], data, sizeof(data)) != static_cast<ssize_t>(sizeof(data)))
+                continue;
+            values.value[k] = data[2] > 0 ? static_cast<double>(data[0]) * data[1] / data[2] : 0.0;
+        }
+        return values;
+    }
+
+private:
+    void control(unsigned long request) {
+        for (int fd : fd_)
+            if (fd >= 0)
+                ioctl(fd, request, 0);
+    }
+
+    int fd_[COUNTERS];
+};
+
+
+// Totals per run over all threads, plus instructions per cycle and the load
+// imbalance (busiest thread's CPU time over the mean), for the benchmark
+// output; with more than one thread also every thread's own counts per run,
+// as name[t]. Unavailable counters are left out.
+inline std::vector<std::pair<std::string, double>> counter_metrics(const std::vector<CounterValues>& threads, int runs) {
+    std::vector<std::pair<std::string, double>> metrics;
+    if (threads.empty() || runs <= 0)
+        return metrics;
+    CounterValues total = threads[0];
+    for (std::size_t t = 1; t < threads.size(); t++)
+        total += threads[t];
+    for (int k = 0; k < COUNTERS; k++)
+        if (total.value[k] >= 0.0)
+            metrics.push_back({counter_name(static_cast<Counter>(k)), total.value[k] / runs});
+    if (total.available(Counter::Cycles) && total.available(Counter::Instructions) && total[Counter::Cycles] > 0.0)
+        metrics.push_back({"ipc", total[Counter::Instructions] / total[Counter::Cycles]});
+    if (threads.size() > 1 && total.available(Counter::TaskClock) && total[Counter::TaskClock] > 0.0) {
+        double busiest = 0.0;
+        for (const CounterValues& v : threads)
+            busiest = std::max(busiest, v[Counter::TaskClock]);
+        metrics.push_back({"imbalance", busiest * threads.size() / total[Counter::TaskClock]});
+    }
+    if (threads.size() > 1)
+        for (int k = 0; k < COUNTERS; k++)
+            if (total.value[k] >= 0.0)
+                for (std::size_t t = 0; t < threads.size(); t++)
+                    metrics.push_back({std::string(counter_name(static_cast<Counter>(k))) + "[" + std::to_string(t) + "]",
+                                       threads[t].value[k] / runs});
+    return metrics;
+}
+
+// The calling thread (and, with `inherit`, the threads it starts), as a
+// probe for measure() and Sweep::run.
+class ThreadCounters {
+public:
+    explicit ThreadCounters(bool inherit = false) : counters_(0, inherit) {}
+
+    void start() { counters_.start(); }
+    void stop() { counters_.stop(); }
+    CounterValues values() const { return counters_.read_values(); }
+    std::vector<std::pair<std::string, double>> metrics(int runs) const { return counter_metrics({values()}, runs); }
+
+private:
+    PerfCounters counters_;
+};
+
+#ifdef _OPENMP
+// One set of counters per member of a `threads`-thread OpenMP team, opened
+// by thread id from a parallel region. Like bind_omp_threads, this relies on
+// the runtime reusing the same pool threads for later regions of that size.
+class TeamCounters {
+public:
+    explicit TeamCounters(int threads) {
+        std::vector<pid_t> tids(threads, 0);
+#pragma omp parallel num_threads(threads)
+        tids[omp_get_thread_num()] = static_cast<pid_t>(syscall(SYS_gettid));
+        for (pid_t tid : tids)
+            counters_.emplace_back(tid);
+    }
+
+    void start() {
+        for (PerfCounters& c : counters_)
+            c.start();
+    }
+
+    void stop() {
+        for (PerfCounters& c : counters_)
+            c.stop();
+    }
+
+    std::vector<CounterValues> per_thread() const {
+        std::vector<CounterValues> values;
+        for (const PerfCounters& c : counters_)
+            values.push_back(c.read_values());
+        return values;
+    }
+
+    std::vector<std::pair<std::string, double>> metrics(int runs) const { return counter_metrics(per_thread(), runs); }
+
+private:
+    std::vector<PerfCounters> counters_;
+};
+#endif
@@ -0,0 +1,391 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <omp.h>
+#include "simd_math.h"
+
+// Composite quadrature over [a, b] split into equal panels, with the rule
+// and the integrand as template parameters so the integrand inlines into
+// the panel loop, which then vectorizes if the integrand is arithmetic:
+//
+//   struct Pi4 { double operator()(double x) const { return 4.0 / (1.0 + x * x); } };
+//   double pi = integrate<GaussLegendre<4>>(Pi4(), 0.0, 1.0, panels);
+//
+// A rule lists its nodes on the unit panel [0, 1) and their weights
+// (summing to 1). Closed rules (trapezoid, Simpson) also have a node at 1
+// with the same weight as the one at 0; each panel then only evaluates its
+// left end, with the weight doubled for the shared end of the previous
+// panel, and the engine corrects the two ends of [a, b] afterwards, so no
+// point is evaluated twice.
+//
+// Error for smooth integrands with panel width h: midpoint and trapezoid
+// O(h^2), Simpson O(h^4), Gauss-Legendre with N points O(h^2N).
+//
+// integrate_adaptive instead refines only where needed: each interval gets
+// a 15-point Gauss-Kronrod value and the difference to the embedded 7-point
+// Gauss value as its error estimate, and is bisected until that estimate is
+// within its share (by width) of the tolerance:
+//
+//   AdaptiveResult r = integrate_adaptive(Pi4(), 0.0, 1.0, 1e-12, 1e-12);
+//   r.value, r.error, r.evaluations
+//
+// Bisections run as OpenMP tasks, so a few hard regions refining deep are
+// spread over the team by the runtime's task stealing.
+//
+// integrate_simd is integrate for integrands that also evaluate
+// SIMD_LANES points at once (simd_math.h), e.g. through vsin where the
+// scalar std::sin call keeps integrate's loop from vectorizing:
+//
+//   struct Sin {
+//       double operator()(double x) const { return std::sin(x); }
+//       void operator()(vdouble& y, const vdouble& x) const { vsin(y, x); }
+//   };
+//
+// Each lane takes one panel, and SIMD_ACCUMULATORS vectors of panels are in
+// flight per iteration, so the adds into the sums do not wait on each other.
+
+struct Midpoint {
+    static constexpr const char* name = "midpoint";
+    static constexpr int points = 1;
+    static constexpr double node[] = {0.5};
+    static constexpr double weight[] = {1.0};
+    static constexpr double end_weight = 0.0;
+};
+
+struct Trapezoid {
+    static constexpr const char* name = "trapezoid";
+    static constexpr int points = 1;
+    static constexpr double node[] = {0.0};
+    static constexpr double weight[] = {1.0};
+    static constexpr double end_weight = 0.5;
+};
+
+struct Simpson {
+    static constexpr const char* name = "simpson";
+    static constexpr int points = 2;
+    static constexpr double node[] = {0.0, 0.5};
+    static constexpr double weight[] = {2.0 / 6.0, 4.0 / 6.0};
+    static constexpr double end_weight = 1.0 / 6.0;
+};
+
+// Nodes (1 + xi) / 2 and weights w / 2 of the N-point Gauss-Legendre rule
+// on [-1, 1], mapped to the unit panel.
+template <int N>
+struct GaussLegendre;
+
+template <>
+struct GaussLegendre<2> {
+    static constexpr const char* name = "gauss-legendre 2";
+    static constexpr int points = 2;
+    static constexpr double node[] = {0.21132486540518711775, 0.78867513459481288225};
+    static constexpr double weight[] = {0.5, 0.5};
+    static constexpr double end_weight = 0.0;
+};
+
+template <>
+struct GaussLegendre<3> {
+    static constexpr const char* name = "gauss-legendre 3";
+    static constexpr int points = 3;
+    static constexpr double node[] = {0.11270166537925831148, 0.5, 0.88729833462074168852};
+    static constexpr double weight[] = {5.0 / 18.0, 8.0 / 18.0, 5.0 / 18.0};
+    static constexpr double end_weight = 0.0;
+};
+
+template <>
+struct GaussLegendre<4> {
+    static constexpr const char* name = "gauss-legendre 4";
+    static constexpr int points = 4;
+    static constexpr double node[] = {0.06943184420297371239, 0.33000947820757186760,
+                                      0.66999052179242813240, 0.93056815579702628761};
+    static constexpr double weight[] = {0.17392742256872692869, 0.32607257743127307131,
+                                        0.32607257743127307131, 0.17392742256872692869};
+    static constexpr double end_weight = 0.0;
+};
+
+template <>
+struct GaussLegendre<5> {
+    static constexpr const char* name = "gauss-legendre 5";
+    static constexpr int points = 5;
+    static constexpr double node[] = {0.04691007703066800360, 0.23076534494715845448, 0.5,
+                                      0.76923465505284154552, 0.95308992296933199640};
+    static constexpr double weight[] = {0.11846344252809454376, 0.23931433524968323402, 0.28444444444444444444,
+                                        0.23931433524968323402, 0.11846344252809454376};
+    static constexpr double end_weight = 0.0;
+};
+
+
+// Integrand evaluations of integrate<Rule> with `panels` panels.
+template <typename Rule>
+long evaluations(long panels) {
+    return panels * Rule::points + (Rule::end_weight != 0.0 ? 2 : 0);
+}
+
+namespace quadrature_detail {
+
+const int PANEL_BLOCK = 4096;
+const int SIMD_ACCUMULATORS = 4;
+
+// Weighted rule values summed over panels [i0, i1) of width h from a. The
+// simd loop runs over blocks with an int index: a 64-bit index has to be
+// converted to double for x, which has no SIMD instruction before AVX-512,
+// and with it GCC leaves the loop scalar.
+template <typename Rule, typename F>
+__attribute__((target_clones("arch=x86-64-v4", "arch=x86-64-v3", "default")))
+static double sum_panels(const F& f, double a, double h, long i0, long i1) {
+    double sum = 0.0;
+    for (long block = i0; block < i1; block += PANEL_BLOCK) {
+        const double first = static_cast<double>(block);
+        const int count = static_cast<int>(std::min<long>(PANEL_BLOCK, i1 - block));
+#pragma omp simd reduction(+:sum)
+        for (int i = 0; i < count; i++) {
+            const double x = a + (first + i) * h;
+            double s = 0.0;
+            for (int k = 0; k < Rule::points; k++)
+                s += Rule::weight[k] * f(x + Rule::node[k] * h);
+            sum += s;
+        }
+    }
+    return sum;
+}
+
+// Weighted rule values summed over panels [i0, i1) of width h from a.
+template <typename Rule, typename F>
+__attribute__((target_clones("arch=x86-64-v4", "arch=x86-64-v3", "default")))
+static double sum_panels_simd(const F& f, double a, double h, long i0, long i1) {
+    vdouble lane, x, y;
+    vdouble acc[SIMD_ACCUMULATORS] = {};
+    lane_index(lane);
+    long i = i0;
+    for (; i + SIMD_ACCUMULATORS * SIMD_LANES <= i1; i += SIMD_ACCUMULATORS * SIMD_LANES) {
+#pragma GCC unroll 4
+        for (int u = 0; u < SIMD_ACCUMULATORS; u++) {
+            const vdouble left = a + (static_cast<double>(i + u * SIMD_LANES) + lane) * h;
+            for (int k = 0; k < Rule::points; k++) {
+                x = left + Rule::node[k] * h;
+                f(y, x);
+                acc[u] += Rule::weight[k] * y;
+            }
+        }
+    }
+    double sum = 0.0;
+    for (int u = 0; u < SIMD_ACCUMULATORS; u++)
+        sum += hsum(acc[u]);
+    for (; i < i1; i++)
+        for (int k = 0; k < Rule::points; k++)
+            sum += Rule::weight[k] * f(a + i * h + Rule::node[k] * h);
+    return sum;
+}
+
+} // namespace quadrature_detail
+
+// The panels are split into one contiguous block per thread of the
+// enclosing OpenMP team; within a thread the panel loop is vectorized when
+// the integrand inlines to arithmetic (a call such as std::sin keeps it
+// scalar; see integrate_simd).
+template <typename Rule, typename F>
+double integrate(F f, double a, double b, long panels) {
+    const double h = (b - a) / panels;
+    double sum = 0.0;
+#pragma omp parallel reduction(+:sum)
+    {
+        const long threads = omp_get_num_threads(), t = omp_get_thread_num();
+        sum += quadrature_detail::sum_panels<Rule>(f, a, h, panels * t / threads, panels * (t + 1) / threads);
+    }
+    if (Rule::end_weight != 0.0)
+        sum += Rule::end_weight * (f(b) - f(a));
+    return sum * h;
+}
+
+// integrate with the panels split into one contiguous block per thread of
+// the enclosing OpenMP team, each summed SIMD_LANES panels at a time.
+template <typename Rule, typename F>
+double integrate_simd(F f, double a, double b, long panels) {
+    const double h = (b - a) / panels;
+    double sum = 0.0;
+#pragma omp parallel reduction(+:sum)
+    {
+        const long threads = omp_get_num_threads(), t = omp_get_thread_num();
+        sum += quadrature_detail::sum_panels_simd<Rule>(f, a, h, panels * t / threads, panels * (t + 1) / threads);
+    }
+    if (Rule::end_weight != 0.0)
+        sum += Rule::end_weight * (f(b) - f(a));
+    return sum * h;
+}
+
+// Fewest panels, doubling from 1, at which integrate<Rule> is within
+// `tolerance` of `exact`; prints them with the evaluation count and error.
+template <typename Rule, typename F>
+long print_convergence(F f, double a, double b, double exact, double tolerance, long max_panels = 1L << 30) {
+    long panels = 1;
+    double error = std::fabs(integrate<Rule>(f, a, b, panels) - exact);
+    while (error > tolerance && panels < max_panels) {
+        panels *= 2;
+        error = std::fabs(integrate<Rule>(f, a, b, panels) - exact);
+    }
+    std::cout << "  " << Rule::name << std::string(18 - std::string(Rule::name).size(), ' ') << panels << " panels, "
+              << evaluations<Rule>(panels) << " evaluations, error " << error << std::endl;
+    return panels;
+}
+
+
+namespace quadrature_detail {
+
+// 15-point Kronrod nodes in units of the half width, from the ends to the
+// center, and weights (QUADPACK qk15); the odd nodes and the center are the
+// 7-point Gauss rule, with GAUSS_WEIGHT.
+const double KRONROD_NODE[8] = {0.991455371120812639206854697526329, 0.949107912342758524526189684047851,
+                                0.864864423359769072789712788640926, 0.741531185599394439863864773280788,
+                                0.586087235467691130294144845693013, 0.405845151377397166906606412076961,
+                                0.207784955007898467600689403773245, 0.0};
+const double KRONROD_WEIGHT[8] = {0.022935322010529224963732008058970, 0.063092092629978553290700663189204,
+                                  0.104790010322250183839876322541518, 0.140653259715525918745189590510238,
+                                  0.169004726639267902826583426598550, 0.190350578064785409913256402421014,
+                                  0.204432940075298892414161999234649, 0.209482141084727828012999174891714};
+const double GAUSS_WEIGHT[4] = {0.129484966168869693270611432679082, 0.279705391489276667901467771423780,
+                                0.381830050505118944950369775488975, 0.417959183673469387755102040816327};
+
+const int KRONROD_POINTS = 15;
+
+struct Estimate {
+    double value, error;
+};
+
+template <typename F>
+Estimate gauss_kronrod(F& f, double a, double b) {
+    const double center = 0.5 * (a + b), half = 0.5 * (b - a);
+    const double fc = f(center);
+    double kronrod = KRONROD_WEIGHT[7] * fc, gauss = GAUSS_WEIGHT[3] * fc;
+    for (int j = 0; j < 7; j++) {
+        const double dx = half * KRONROD_NODE[j];
+        const double pair = f(center - dx) + f(center + dx);
+        kronrod += KRONROD_WEIGHT[j] * pair;
+        if (j % 2 == 1)
+            gauss += GAUSS_WEIGHT[j / 2] * pair;
+    }
+    return {kronrod * half, std::fabs((kronrod - gauss) * half)};
+}
+
+// Sums of one thread, padded to a cache line so threads never share one.
+struct alignas(64) Partial {
+    double value = 0.0, error = 0.0;
+    long intervals = 0;
+};
+
+template <typename F>
+struct Adaptive {
+    F& f;
+    double tolerance_density;   // allowed error per unit of width
+    int max_depth;
+    int spawn_limit;            // queued tasks above which bisection goes on inline
+    std::vector<Partial> partials;
+    std::atomic<long> evaluations{0};
+    std::atomic<int> queued{0};
+
+    void accept(const Estimate& e) {
+        Partial& p = partials[omp_get_thread_num()];
+        p.value += e.value;
+        p.error += e.error;
+        p.intervals++;
+    }
+
+    void refine(double a, double b, Estimate e, int depth) {
+        if (e.error <= tolerance_density * (b - a)) {
+            accept(e);
+            return;
+        }
+        const double m = 0.5 * (a + b);
+        // out of depth, or the halves no longer differ in double precision;
+        // near an integrable singularity the error shrinks slower than the
+        // width and this is where refinement ends
+        if (depth >= max_depth || m <= a || m >= b) {
+            accept(e);
+            return;
+        }
+        const Estimate left = gauss_kronrod(f, a, m), right = gauss_kronrod(f, m, b);
+        evaluations += 2 * KRONROD_POINTS;
+        if (queued.load(std::memory_order_relaxed) < spawn_limit) {
+            queued++;
+#pragma omp task firstprivate(a, m, left, depth)
+            {
+                queued--;
+                refine(a, m, left, depth + 1);
+            }
+        } else {
+            refine(a, m, left, depth + 1);
+        }
+        refine(m, b, right, depth + 1);
+    }
+};
+
+} // namespace quadrature_detail
+
+
+struct AdaptiveResult {
+    double value = 0.0;
+    double error = 0.0;       // sum of the accepted intervals' estimates
+    long evaluations = 0;
+    long intervals = 0;
+    bool converged = true;    // error within the tolerance
+};
+
+// Adaptive 15-point Gauss-Kronrod on [a, b] to within
+// max(abs_tolerance, rel_tolerance * |value|), over the enclosing OpenMP
+// team. [a, b] is first split into a few panels per thread, whose sum sets
+// the relative target; each panel that misses its share is bisected
+// recursively, the halves becoming tasks while fewer than 4 per thread are
+// queued. Since every interval must meet the tolerance for its width, the
+// error estimate can end well below the target.
+template <typename F>
+AdaptiveResult integrate_adaptive(F f, double a, double b, double abs_tolerance, double rel_tolerance = 0.0,
+                                  int max_depth = 50) {
+    using namespace quadrature_detail;
+    const int threads = omp_get_max_threads();
+    const int panels = 4 * threads;
+    std::vector<Estimate> first(panels);
+    const double h = (b - a) / panels;
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < panels; i++)
+        first[i] = gauss_kronrod(f, a + i * h, i + 1 == panels ? b : a + (i + 1) * h);
+
+    double estimate = 0.0;
+    for (const Estimate& e : first)
+        estimate += e.value;
+    const double tolerance = std::max(abs_tolerance, rel_tolerance * std::fabs(estimate));
+
+    Adaptive<F> adaptive{f, tolerance / std::fabs(b - a), max_depth, 4 * threads, std::vector<Partial>(threads)};
+    adaptive.evaluations = static_cast<long>(panels) * KRONROD_POINTS;
+#pragma omp parallel num_threads(threads)
+#pragma omp single
+    for (int i = 0; i < panels; i++) {
+        const double left = a + i * h, right = i + 1 == panels ? b : a + (i + 1) * h;
+        const Estimate e = first[i];
+#pragma omp task firstprivate(left, right, e)
+        adaptive.refine(left, right, e, 0);
+    }
+
+    AdaptiveResult result;
+    for (const Partial& p : adaptive.partials) {
+        result.value += p.value;
+        result.error += p.error;
+        result.intervals += p.intervals;
+    }
+    result.converged = result.error <= tolerance;
+    result.evaluations = adaptive.evaluations;
+    return result;
+}
+
+// One line per tolerance: value, estimated and true error, evaluations.
+template <typename F>
+void print_adaptive(F f, double a, double b, double exact, const std::vector<double>& tolerances) {
+    for (double tolerance : tolerances) {
+        AdaptiveResult r = integrate_adaptive(f, a, b, tolerance, tolerance);
+        std::cout << "  tolerance " << tolerance << ": " << r.evaluations << " evaluations, " << r.intervals
+                  << " intervals, estimated error " << r.error << ", error " << std::fabs(r.value - exact)
+                  << (r.converged ? "" : " (not converged)") << std::endl;
+    }
+}
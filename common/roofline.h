@@ -0,0 +1,314 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <omp.h>
+#include <unistd.h>
+#include "bench.h"
+
+// Roofline characterization: measured machine limits next to what the
+// annotated kernels of a Sweep achieved.
+//
+//   sweep.annotate(2.0 * n * n, 8.0 * n * n);   // flops and bytes of one run
+//   ... sweep.run(...) ...
+//   if (roofline_mode())                        // $ROOFLINE set and not 0
+//       print_roofline(sweep.records());
+//
+// For every thread count in the records it measures
+//
+//   STREAM copy, scale and triad (2, 2 and 3 arrays of doubles, counted as
+//   the bytes the loop reads and writes) and a read-only sum, which is the
+//   roof of kernels like GEMV that write almost nothing, with working sets
+//   sized to half of each data cache level and to four times the last level
+//   for DRAM (at most a quarter of the free memory); each kind allocates
+//   only the arrays it touches
+//   peak flops from independent multiply-add chains, FMA where the CPU has
+//   it (cloned for AVX-512, AVX2 and baseline x86-64)
+//
+// and prints, per record, the achieved GFLOP/s and GB/s, the arithmetic
+// intensity, the roof min(peak, bandwidth * intensity) with the bandwidth of
+// the smallest level that holds the kernel's bytes, and the fraction of that
+// roof reached. Per-thread cache shares: a cache of size S shared by k CPUs
+// gives t threads S * max(1, t / k), t capped at the processor count.
+//
+// The probes only mean something in an optimized build.
+
+inline bool roofline_mode() {
+    const char* env = std::getenv("ROOFLINE");
+    return env && *env && std::string(env) != "0";
+}
+
+struct CacheLevel {
+    int level;
+    std::size_t bytes;
+    int shared_by;  // CPUs sharing one instance
+};
+
+struct MemoryRoof {
+    std::string name;    // L1, L2, L3, DRAM
+    std::size_t capacity;  // bytes the threads can keep at this level, 0 for DRAM
+    double read, copy, scale, triad;  // GB/s
+
+    double best() const { return std::max(std::max(read, copy), std::max(scale, triad)); }
+};
+
+struct Roofs {
+    int threads;
+    double peak_gflops;
+    std::vector<MemoryRoof> memory;  // innermost first
+};
+
+
+namespace roofline_detail {
+
+typedef double vec __attribute__((vector_size(64)));
+
+const int FMA_CHAINS = 8;
+
+inline std::size_t parse_size(const std::string& text) {
+    std::size_t value = std::strtoul(text.c_str(), nullptr, 10);
+    char unit = text.empty() ? ' ' : text.back();
+    return unit == 'K' ? value << 10 : unit == 'M' ? value << 20 : unit == 'G' ? value << 30 : value;
+}
+
+inline int count_cpus(const std::string& list) {
+    int count = 0;
+    std::size_t pos = 0;
+    while (pos < list.size()) {
+        std::size_t end = list.find(',', pos);
+        if (end == std::string::npos)
+            end = list.size();
+        std::string item = list.substr(pos, end - pos);
+        std::size_t dash = item.find('-');
+        count += dash == std::string::npos ? 1 : std::atoi(item.c_str() + dash + 1) - std::atoi(item.c_str()) + 1;
+        pos = end + 1;
+    }
+    return std::max(count, 1);
+}
+
+// Independent chains of acc = acc * m + a, 2 flops per lane each.
+__attribute__((target_clones("arch=x86-64-v4", "arch=x86-64-v3", "default")))
+static double fma_chains(long iterations) {
+    vec acc[FMA_CHAINS];
+    vec m, a;
+    for (int l = 0; l < 8; l++) {
+        m[l] = 1.0 - 1e-12;
+        a[l] = 1e-12;
+    }
+#pragma GCC unroll 8
+    for (int k = 0; k < FMA_CHAINS; k++)
+        acc[k] = m * (k + 1);
+    for (long it = 0; it < iterations; it++) {
+#pragma GCC unroll 8
+        for (int k = 0; k < FMA_CHAINS; k++)
+            acc[k] = acc[k] * m + a;
+    }
+    double sum = 0.0;
+    for (int k = 0; k < FMA_CHAINS; k++)
+        for (int l = 0; l < 8; l++)
+            sum += acc[k][l];
+    return sum;
+}
+
+// Sum of p[0..n), four vector accumulators so it is bound by loads rather
+// than by the latency of one add chain.
+__attribute__((target_clones("arch=x86-64-v4", "arch=x86-64-v3", "default")))
+static double read_sum(const double* p, long n) {
+    vec acc[4] = {};
+    long i = 0;
+    for (; i + 32 <= n; i += 32) {
+#pragma GCC unroll 4
+        for (int k = 0; k < 4; k++) {
+            vec v;
+            __builtin_memcpy(&v, p + i + 8 * k, sizeof(v));
+            acc[k] += v;
+        }
+    }
+    vec total = acc[0] + acc[1] + acc[2] + acc[3];
+    double sum = 0.0;
+    for (int l = 0; l < 8; l++)
+        sum += total[l];
+    for (; i < n; i++)
+        sum += p[i];
+    return sum;
+}
+
+// bytes of physical memory not in use
+inline std::size_t free_memory() {
+    return static_cast<std::size_t>(sysconf(_SC_AVPHYS_PAGES)) * sysconf(_SC_PAGESIZE);
+}
+
+enum class Stream { Read, Copy, Scale, Triad };
+
+// GB/s of `kind` over `bytes` of arrays split evenly over `threads` threads,
+// each thread sweeping its own part, best of a few timed batches.
+inline double stream(Stream kind, std::size_t bytes, int threads) {
+    const int arrays = kind == Stream::Triad ? 3 : kind == Stream::Read ? 1 : 2;
+    const long n = std::max<long>(bytes / (arrays * sizeof(double)), 64 * threads);
+    // only the arrays the kind touches: b for read, a and b for copy and
+    // scale, all three for triad; left uninitialized, so the fill of batch 0
+    // is the first touch and places every page with its thread
+    std::unique_ptr<double[]> a(kind == Stream::Read ? nullptr : new double[n]), b(new double[n]),
+        c(kind == Stream::Triad ? new double[n] : nullptr);
+    // enough sweeps that a batch moves at least ~256 MiB
+    const long sweeps = std::max<long>(1, (256l << 20) / (n * arrays * sizeof(double)));
+    const double s = 3.0;
+    double best = 0.0, total = 0.0;
+    for (int batch = 0; batch < 4; batch++) {
+        auto start_time = std::chrono::high_resolution_clock::now();
+#pragma omp parallel num_threads(threads) reduction(+:total)
+        {
+            const long t = omp_get_thread_num();
+            const long i0 = n * t / threads, i1 = n * (t + 1) / threads;
+            double* pa = a.get();
+            double* pb = b.get();
+            double* pc = c.get();
+            if (batch == 0) {  // first touch by the thread that sweeps the part
+                if (pa)
+                    std::fill(pa + i0, pa + i1, 0.0);
+                std::fill(pb + i0, pb + i1, 1.0);
+                if (pc)
+                    std::fill(pc + i0, pc + i1, 2.0);
+            }
+            for (long r = 0; r < sweeps; r++) {
+                if (kind == Stream::Read) {
+                    total += read_sum(pb + i0, i1 - i0);
+                } else if (kind == Stream::Copy) {
+#pragma omp simd
+                    for (long i = i0; i < i1; i++)
+                        pa[i] = pb[i];
+                } else if (kind == Stream::Scale) {
+#pragma omp simd
+                    for (long i = i0; i < i1; i++)
+                        pa[i] = s * pb[i];
+                } else {
+#pragma omp simd
+                    for (long i = i0; i < i1; i++)
+                        pa[i] = pb[i] + s * pc[i];
+                }
+            }
+        }
+        auto end_time = std::chrono::high_resolution_clock::now();
+        double seconds = std::chrono::duration<double>(end_time - start_time).count();
+        if (batch > 0)  // batch 0 also pays for the page faults
+            best = std::max(best, sweeps * n * arrays * sizeof(double) / seconds / 1e9);
+    }
+    volatile double sink = (a ? a[n / 2] : 0.0) + total;
+    (void)sink;
+    return best;
+}
+
+} // namespace roofline_detail
+
+
+// Data and unified caches of CPU 0, innermost first.
+inline std::vector<CacheLevel> data_caches() {
+    std::vector<CacheLevel> caches;
+    for (int index = 0;; index++) {
+        const std::string dir = "/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(index) + "/";
+        std::ifstream level_file(dir + "level"), type_file(dir + "type"), size_file(dir + "size"), shared_file(dir + "shared_cpu_list");
+        int level;
+        std::string type, size, shared;
+        if (!(level_file >> level && type_file >> type && size_file >> size))
+            break;
+        if (type == "Instruction")
+            continue;
+        shared_file >> shared;
+        caches.push_back({level, roofline_detail::parse_size(size), roofline_detail::count_cpus(shared)});
+    }
+    std::sort(caches.begin(), caches.end(), [](const CacheLevel& a, const CacheLevel& b) { return a.level < b.level; });
+    return caches;
+}
+
+// GFLOP/s of `threads` threads running independent multiply-add chains.
+inline double peak_gflops(int threads) {
+    const long iterations = 1 << 24;
+    double best = 0.0;
+    for (int batch = 0; batch < 3; batch++) {
+        double sink = 0.0;
+        auto start_time = std::chrono::high_resolution_clock::now();
+#pragma omp parallel num_threads(threads) reduction(+:sink)
+        sink += roofline_detail::fma_chains(iterations);
+        auto end_time = std::chrono::high_resolution_clock::now();
+        double seconds = std::chrono::duration<double>(end_time - start_time).count();
+        volatile double keep = sink;
+        (void)keep;
+        best = std::max(best, 2.0 * 8 * roofline_detail::FMA_CHAINS * iterations * threads / seconds / 1e9);
+    }
+    return best;
+}
+
+inline Roofs measure_roofs(int threads) {
+    using roofline_detail::Stream;
+    Roofs roofs;
+    roofs.threads = threads;
+    roofs.peak_gflops = peak_gflops(threads);
+    std::vector<CacheLevel> caches = data_caches();
+    std::size_t last = 64 << 20;
+    for (const CacheLevel& cache : caches) {
+        std::size_t capacity = cache.bytes * std::max(1, std::min(threads, omp_get_num_procs()) / cache.shared_by);
+        std::size_t set = capacity / 2;
+        roofs.memory.push_back({"L" + std::to_string(cache.level), capacity, roofline_detail::stream(Stream::Read, set, threads),
+                                roofline_detail::stream(Stream::Copy, set, threads), roofline_detail::stream(Stream::Scale, set, threads),
+                                roofline_detail::stream(Stream::Triad, set, threads)});
+        last = capacity;
+    }
+    // no more than a quarter of the free physical memory, so a small or
+    // busy machine measures DRAM rather than swap
+    std::size_t set = std::min(4 * last, roofline_detail::free_memory() / 4);
+    roofs.memory.push_back({"DRAM", 0, roofline_detail::stream(Stream::Read, set, threads), roofline_detail::stream(Stream::Copy, set, threads),
+                            roofline_detail::stream(Stream::Scale, set, threads), roofline_detail::stream(Stream::Triad, set, threads)});
+    return roofs;
+}
+
+inline void print_roofs(const Roofs& roofs, std::ostream& out = std::cout) {
+    out << roofs.threads << " threads: peak " << roofs.peak_gflops << " GFLOP/s" << std::endl;
+    for (const MemoryRoof& m : roofs.memory)
+        out << "  " << m.name << ": read " << m.read << ", copy " << m.copy << ", scale " << m.scale << ", triad " << m.triad << " GB/s" << std::endl;
+}
+
+// Achieved vs attainable for every annotated record, measuring the roofs of
+// each thread count once.
+inline void print_roofline(const std::vector<BenchRecord>& records, std::ostream& out = std::cout) {
+    std::map<int, Roofs> roofs;
+    out << std::endl << "Machine roofs:" << std::endl;
+    for (const BenchRecord& r : records)
+        if (r.flops > 0.0 && !roofs.count(r.threads)) {
+            roofs[r.threads] = measure_roofs(r.threads);
+            print_roofs(roofs[r.threads], out);
+        }
+
+    out << std::endl << "Roofline:" << std::endl;
+    out << "| kernel | size | threads | GFLOP/s | GB/s | flop/B | level | roof, GFLOP/s | of roof | bound |" << std::endl;
+    out << "|--------|------|---------|---------|------|--------|-------|---------------|---------|-------|" << std::endl;
+    for (const BenchRecord& r : records) {
+        if (r.flops <= 0.0 || r.stats.median <= 0.0)
+            continue;
+        const Roofs& machine = roofs[r.threads];
+        const MemoryRoof* level = &machine.memory.back();
+        for (const MemoryRoof& m : machine.memory)
+            if (m.capacity > 0 && r.bytes <= m.capacity) {
+                level = &m;
+                break;
+            }
+        const double gflops = r.flops / r.stats.median / 1e9;
+        const double gbs = r.bytes / r.stats.median / 1e9;
+        const double memory_roof = r.bytes > 0.0 ? level->best() * r.flops / r.bytes : machine.peak_gflops;
+        const double roof = std::min(machine.peak_gflops, memory_roof);
+        out << "| " << r.kernel << " | " << r.size << " | " << r.threads << " | " << gflops << " | " << gbs << " | ";
+        if (r.bytes > 0.0)
+            out << r.flops / r.bytes;
+        else
+            out << "inf";
+        out << " | " << (r.bytes > 0.0 ? level->name : "-") << " | " << roof << " | " << 100.0 * gflops / roof << "% | "
+            << (memory_roof < machine.peak_gflops ? "memory" : "compute") << " |" << std::endl;
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+
+// Elementary functions on SIMD_LANES doubles at a time, written with GCC
+// vector extensions so the same code compiles to AVX-512, AVX2 or SSE2
+// depending on the target of the function it is inlined into (see the
+// target_clones kernels in quadrature.h).
+//
+// vsin follows fdlibm: x = n * pi/2 + r with |r| <= pi/4, pi/2 split in
+// three parts (Cody-Waite) so r is exact to about 1e-19 for |x| < 1e6; then
+// the degree 13 sine or degree 14 cosine minimax polynomial on r, chosen and
+// signed per lane by the quadrant n mod 4. Error within 2 ulp of std::sin
+// on that range; larger |x| loses accuracy gradually (no Payne-Hanek).
+//
+// Vectors are passed and returned by reference, since by value the calling
+// convention would depend on -mavx (as in gemv.h).
+
+const int SIMD_LANES = 8;
+
+typedef double vdouble __attribute__((vector_size(SIMD_LANES * sizeof(double))));
+typedef std::int64_t vint64 __attribute__((vector_size(SIMD_LANES * sizeof(std::int64_t))));
+
+__attribute__((always_inline)) inline double hsum(const vdouble& v) {
+    double s = 0.0;
+    for (int l = 0; l < SIMD_LANES; l++)
+        s += v[l];
+    return s;
+}
+
+// {0, 1, ..., SIMD_LANES - 1}
+__attribute__((always_inline)) inline void lane_index(vdouble& out) {
+    for (int l = 0; l < SIMD_LANES; l++)
+        out[l] = l;
+}
+
+__attribute__((always_inline)) inline void vsin(vdouble& out, const vdouble& x) {
+    const double two_over_pi = 6.36619772367581382433e-01;
+    const double pio2_1 = 1.57079632673412561417e+00;   // first 33 bits of pi/2
+    const double pio2_2 = 6.07710050630396597660e-11;   // next 33 bits
+    const double pio2_3 = 2.02226624871116645580e-21;   // the rest
+    // adding and subtracting 1.5 * 2^52 rounds to the nearest integer
+    const double round = 6755399441055744.0;
+
+    const vdouble n = (x * two_over_pi + round) - round;
+    const vdouble r = ((x - n * pio2_1) - n * pio2_2) - n * pio2_3;
+    const vdouble z = r * r;
+
+    const vdouble sin_r = r + r * z * (-1.66666666666666324348e-01 + z * (8.33333333332248946124e-03 +
+                          z * (-1.98412698298579493134e-04 + z * (2.75573137070700676789e-06 +
+                          z * (-2.50507602534068634195e-08 + z * 1.58969099521155010221e-10)))));
+    const vdouble cos_r = 1.0 - 0.5 * z + z * z * (4.16666666666666019037e-02 + z * (-1.38888888888741095749e-03 +
+                          z * (2.48015872894767294178e-05 + z * (-2.75573143513906633035e-07 +
+                          z * (2.08757232129817482790e-09 + z * -1.13596475577881948265e-11)))));
+
+    const vint64 quadrant = __builtin_convertvector(n, vint64);
+    out = (quadrant & 1) != 0 ? cos_r : sin_r;
+    out = (quadrant & 2) != 0 ? -out : out;
+}
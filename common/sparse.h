@@ -0,0 +1,232 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <numeric>
+#include <thread>
+#include <vector>
+#include <omp.h>
+#include "matrix.h"
+
+// Sparse row-oriented formats and y = A*x for them.
+//
+//   CsrMatrix   compressed rows: row_ptr[i]..row_ptr[i + 1] index col/val
+//   EllMatrix   every row padded to the longest one, `width` slots per row;
+//               padding has value 0 and repeats a real column, so the kernel
+//               needs no branches
+//   SellMatrix  SELL-C-sigma: rows sorted by length inside windows of sigma
+//               rows, then cut into chunks of C rows, each padded to its own
+//               longest row and stored slot-major so the C rows of a chunk
+//               are processed as one vector
+//
+// Each format splits its rows into work units (rows, or chunks for SELL) and
+// exposes `work` as a prefix sum of stored entries over them. The parallel
+// kernels cut that prefix sum into equal parts, so every thread gets the
+// same number of nonzeros rather than the same number of rows.
+
+template <typename T>
+struct CsrMatrix {
+    std::size_t rows = 0, cols = 0;
+    std::vector<long> row_ptr;
+    std::vector<int> col;
+    std::vector<T> val;
+
+    std::size_t nnz() const { return val.size(); }
+    const std::vector<long>& work() const { return row_ptr; }
+
+    // y[i] = A[i, :] . x for rows i in [u0, u1)
+    void multiply(const T* x, T* y, long u0, long u1) const {
+        for (long i = u0; i < u1; i++) {
+            T sum = 0;
+            for (long k = row_ptr[i]; k < row_ptr[i + 1]; k++)
+                sum += val[k] * x[col[k]];
+            y[i] = sum;
+        }
+    }
+};
+
+template <typename T>
+struct EllMatrix {
+    std::size_t rows = 0, cols = 0, width = 0;
+    std::vector<int> col;  // rows * width, row-major
+    std::vector<T> val;
+    std::vector<long> prefix;
+
+    std::size_t stored() const { return val.size(); }
+    const std::vector<long>& work() const { return prefix; }
+
+    void multiply(const T* x, T* y, long u0, long u1) const {
+        for (long i = u0; i < u1; i++) {
+            const int* c = col.data() + i * width;
+            const T* v = val.data() + i * width;
+            T sum = 0;
+            for (std::size_t s = 0; s < width; s++)
+                sum += v[s] * x[c[s]];
+            y[i] = sum;
+        }
+    }
+};
+
+template <typename T, int C = 8>
+struct SellMatrix {
+    std::size_t rows = 0, cols = 0, sigma = 0;
+    std::vector<int> perm;          // chunk row -> original row, -1 for padding rows
+    std::vector<long> chunk_ptr;    // first entry of each chunk, prefix sum of C * width
+    std::vector<int> col;           // chunk-local slot-major: entry (slot s, lane r) at chunk_ptr + s * C + r
+    std::vector<T> val;
+
+    std::size_t stored() const { return val.size(); }
+    const std::vector<long>& work() const { return chunk_ptr; }
+
+    // rows of chunks [u0, u1)
+    void multiply(const T* x, T* y, long u0, long u1) const {
+        for (long c = u0; c < u1; c++) {
+            long width = (chunk_ptr[c + 1] - chunk_ptr[c]) / C;
+            const int* cc = col.data() + chunk_ptr[c];
+            const T* vv = val.data() + chunk_ptr[c];
+            T sum[C] = {};
+            for (long s = 0; s < width; s++)
+#pragma omp simd
+                for (int r = 0; r < C; r++)
+                    sum[r] += vv[s * C + r] * x[cc[s * C + r]];
+            for (int r = 0; r < C; r++) {
+                int row = perm[c * C + r];
+                if (row >= 0)
+                    y[row] = sum[r];
+            }
+        }
+    }
+};
+
+
+template <typename T>
+CsrMatrix<T> to_csr(const Matrix<T>& dense) {
+    CsrMatrix<T> a;
+    a.rows = dense.rows();
+    a.cols = dense.cols();
+    a.row_ptr.assign(1, 0);
+    for (std::size_t i = 0; i < a.rows; i++) {
+        Span<const T> row = dense.row(i);
+        for (std::size_t j = 0; j < a.cols; j++)
+            if (row[j] != T(0)) {
+                a.col.push_back(static_cast<int>(j));
+                a.val.push_back(row[j]);
+            }
+        a.row_ptr.push_back(static_cast<long>(a.val.size()));
+    }
+    return a;
+}
+
+template <typename T>
+EllMatrix<T> to_ell(const CsrMatrix<T>& a) {
+    EllMatrix<T> e;
+    e.rows = a.rows;
+    e.cols = a.cols;
+    for (std::size_t i = 0; i < a.rows; i++)
+        e.width = std::max<std::size_t>(e.width, a.row_ptr[i + 1] - a.row_ptr[i]);
+    e.col.assign(e.rows * e.width, 0);
+    e.val.assign(e.rows * e.width, T(0));
+    for (std::size_t i = 0; i < a.rows; i++) {
+        long length = a.row_ptr[i + 1] - a.row_ptr[i];
+        for (std::size_t s = 0; s < e.width; s++) {
+            // padding repeats the last real column: zero times a cached x
+            long k = a.row_ptr[i] + std::min<long>(s, length - 1);
+            if (length > 0)
+                e.col[i * e.width + s] = a.col[k];
+            if (static_cast<long>(s) < length)
+                e.val[i * e.width + s] = a.val[k];
+        }
+    }
+    e.prefix.resize(e.rows + 1);
+    for (std::size_t i = 0; i <= e.rows; i++)
+        e.prefix[i] = static_cast<long>(i * e.width);
+    return e;
+}
+
+// sigma = 1 keeps the original row order; sigma = rows sorts globally.
+template <typename T, int C = 8>
+SellMatrix<T, C> to_sell(const CsrMatrix<T>& a, std::size_t sigma = 256) {
+    SellMatrix<T, C> s;
+    s.rows = a.rows;
+    s.cols = a.cols;
+    s.sigma = std::max<std::size_t>(sigma, 1);
+    const std::size_t chunks = (a.rows + C - 1) / C;
+
+    auto length = [&a](int i) { return a.row_ptr[i + 1] - a.row_ptr[i]; };
+    s.perm.assign(chunks * C, -1);
+    std::iota(s.perm.begin(), s.perm.begin() + a.rows, 0);
+    for (std::size_t w = 0; w < a.rows; w += s.sigma) {
+        auto last = s.perm.begin() + std::min(a.rows, w + s.sigma);
+        std::stable_sort(s.perm.begin() + w, last, [&](int p, int q) { return length(p) > length(q); });
+    }
+
+    s.chunk_ptr.assign(chunks + 1, 0);
+    for (std::size_t c = 0; c < chunks; c++) {
+        long width = 0;
+        for (int r = 0; r < C; r++)
+            if (s.perm[c * C + r] >= 0)
+                width = std::max(width, length(s.perm[c * C + r]));
+        s.chunk_ptr[c + 1] = s.chunk_ptr[c] + width * C;
+    }
+
+    s.col.assign(s.chunk_ptr[chunks], 0);
+    s.val.assign(s.chunk_ptr[chunks], T(0));
+    for (std::size_t c = 0; c < chunks; c++) {
+        long width = (s.chunk_ptr[c + 1] - s.chunk_ptr[c]) / C;
+        for (int r = 0; r < C; r++) {
+            int row = s.perm[c * C + r];
+            long n = row >= 0 ? length(row) : 0;
+            for (long k = 0; k < width; k++) {
+                long dst = s.chunk_ptr[c] + k * C + r;
+                if (n > 0)
+                    s.col[dst] = a.col[a.row_ptr[row] + std::min(k, n - 1)];
+                if (k < n)
+                    s.val[dst] = a.val[a.row_ptr[row] + k];
+            }
+        }
+    }
+    return s;
+}
+
+
+// Boundary of part `p` out of `parts` over the work units of a prefix sum:
+// the first unit whose starting offset reaches p/parts of the total.
+inline long balanced_split(const std::vector<long>& prefix, long p, long parts) {
+    const long units = static_cast<long>(prefix.size()) - 1;
+    if (p <= 0)
+        return 0;
+    if (p >= parts)
+        return units;
+    long target = prefix[units] * p / parts;
+    return std::lower_bound(prefix.begin(), prefix.end(), target) - prefix.begin();
+}
+
+// y = A*x with the work split by stored entries across the OpenMP team.
+template <typename M, typename T>
+void spmv_omp(const M& a, const T* x, T* y) {
+#pragma omp parallel
+    {
+        long threads = omp_get_num_threads();
+        long t = omp_get_thread_num();
+        long u0 = balanced_split(a.work(), t, threads);
+        long u1 = balanced_split(a.work(), t + 1, threads);
+        a.multiply(x, y, u0, u1);
+    }
+}
+
+// Same split, one std::thread per part.
+template <typename M, typename T>
+void spmv_threads(const M& a, const T* x, T* y, int threads) {
+    if (threads <= 1) {
+        a.multiply(x, y, 0, static_cast<long>(a.work().size()) - 1);
+        return;
+    }
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        long u0 = balanced_split(a.work(), t, threads);
+        long u1 = balanced_split(a.work(), t + 1, threads);
+        workers.emplace_back([&a, x, y, u0, u1] { a.multiply(x, y, u0, u1); });
+    }
+    for (auto& worker : workers)
+        worker.join();
+}
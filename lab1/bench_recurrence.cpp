@@ -0,0 +1,73 @@
+#include <iostream>
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include "sin_simd.h"
+#include "sin_recurrence.h"
+#include "bench.h"
+
+const int SIZE = 10000000;
+
+
+template <typename Type>
+double max_abs_error(const std::vector<Type>& array) {
+    const long double two_pi = 6.283185307179586476925286766559L;
+    long n = array.size();
+    double worst = 0.0;
+    for (long i = 0; i < n; i++) {
+        double err = static_cast<double>(std::fabs(array[i] - std::sin(two_pi * i / n)));
+        if (err > worst)
+            worst = err;
+    }
+    return worst;
+}
+
+template <typename Type>
+void run(Sweep& sweep, const char* type_name, const std::vector<double>& tolerances) {
+    std::vector<Type> array(SIZE);
+    int threads = std::thread::hardware_concurrency();
+
+    sweep.annotate(0.0, SIZE * sizeof(Type));
+    const std::string type(type_name);
+    double direct_time = sweep.run(type + " std::sin", SIZE, 1, [&] {
+        for (int i = 0; i < SIZE; i++)
+            array[i] = static_cast<Type>(std::sin(2 * M_PI * i / SIZE));
+    }).stats.median;
+    std::cout << type_name << " std::sin: " << direct_time << " sec, max abs error "
+              << max_abs_error(array) << std::endl;
+
+    double simd_time = sweep.run(type + " sin_2pi_fill", SIZE, 1, [&] {
+        sin_2pi_fill(array.data(), 0, SIZE, SIZE);
+    }).stats.median;
+    std::cout << type_name << " sin_2pi_fill (" << simd_isa_name(detect_simd_isa()) << "): " << simd_time
+              << " sec, max abs error " << max_abs_error(array) << std::endl;
+
+    for (double tolerance : tolerances) {
+        for (int t : {1, threads}) {
+            std::ostringstream kernel;
+            kernel << type << " recurrence tol " << tolerance;
+            double runtime = sweep.run(kernel.str(), SIZE, t, [&] {
+                sin_2pi_recurrence_fill(array.data(), 0, SIZE, SIZE, tolerance, t);
+            }).stats.median;
+            double error = max_abs_error(array);
+            std::cout << type_name << " recurrence tol " << tolerance << ", " << t << " threads, segment "
+                      << recurrence_segment_length<Type>(SIZE, tolerance) << ": " << runtime << " sec, speedup "
+                      << direct_time / runtime << ", max abs error " << error
+                      << (error <= tolerance ? "" : " (over tolerance)") << std::endl;
+            if (threads == 1)
+                break;
+        }
+    }
+    std::cout << std::endl;
+}
+
+
+int main() {
+    Sweep sweep("lab1 bench_recurrence");
+    run<float>(sweep, "float", {1e-6, 1e-7});
+    run<double>(sweep, "double", {1e-12, 1e-14, 1e-15});
+    sweep.save();
+    return 0;
+}
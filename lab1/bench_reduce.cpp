@@ -0,0 +1,57 @@
+#include <iostream>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <thread>
+#include "sin_simd.h"
+#include "reduce.h"
+#include "bench.h"
+
+const int SIZE = 10000000;
+
+
+// compensated long double sum, accurate far beyond double for this input
+template <typename Type>
+long double reference_sum(const std::vector<Type>& array) {
+    long double sum = 0, comp = 0;
+    for (Type v : array)
+        reduce_detail::neumaier_add(sum, comp, static_cast<long double>(v));
+    return sum + comp;
+}
+
+template <typename Acc, typename Type>
+void run(Sweep& sweep, const char* name, const std::vector<Type>& array, long double reference) {
+    std::vector<SumStrategy> strategies = {SumStrategy::Naive, SumStrategy::Multi, SumStrategy::Pairwise,
+                                           SumStrategy::Neumaier, SumStrategy::Tree};
+    int threads = std::thread::hardware_concurrency();
+
+    sweep.annotate(array.size(), array.size() * sizeof(Type));
+    for (SumStrategy strategy : strategies) {
+        Acc sum = 0;
+        // only the tree uses the threads
+        int used = strategy == SumStrategy::Tree ? threads : 1;
+        double median = sweep.run(std::string(name) + " " + sum_strategy_name(strategy), array.size(), used, [&] {
+            sum = reduce_sum<Acc>(strategy, array.data(), array.size(), threads);
+        }).stats.median;
+        double error = static_cast<double>(std::fabs(sum - reference));
+        std::cout << name << " " << sum_strategy_name(strategy) << ": " << median << " sec, "
+                  << array.size() * sizeof(Type) / median / 1e9 << " GB/s, abs error " << error << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+
+int main() {
+    std::vector<float> array_f(SIZE);
+    std::vector<double> array_d(SIZE);
+    sin_2pi_fill(array_f.data(), 0, SIZE, SIZE);
+    sin_2pi_fill(array_d.data(), 0, SIZE, SIZE);
+
+    std::cout << "Threads for tree: " << std::thread::hardware_concurrency() << std::endl << std::endl;
+    Sweep sweep("lab1 bench_reduce");
+    run<float>(sweep, "float/float", array_f, reference_sum(array_f));
+    run<double>(sweep, "float/double", array_f, reference_sum(array_f));
+    run<double>(sweep, "double/double", array_d, reference_sum(array_d));
+    sweep.save();
+    return 0;
+}
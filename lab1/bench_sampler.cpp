@@ -0,0 +1,65 @@
+#include <iostream>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <type_traits>
+#include "sin_simd.h"
+#include "bench.h"
+
+const int SIZE = 10000000;
+
+
+// cos(2*pi*i/n) = sin(2*pi*(i + n/4)/n), only for n divisible by 4
+struct Cos2Pi {
+    static const unsigned symmetry = Periodic | Even;
+
+    template <typename T>
+    void operator()(T* out, long begin, long count, long n) const {
+        sin_2pi_fill(out, begin + n / 4, count, n);
+    }
+};
+
+template <typename T, typename F>
+bool identical(const F& f, long n) {
+    std::vector<T> direct(n), sampled(n);
+    f(direct.data(), 0, n, n);
+    sample_period(f, sampled.data(), n);
+    return std::memcmp(direct.data(), sampled.data(), n * sizeof(T)) == 0;
+}
+
+template <typename T, typename F>
+void run(Sweep& sweep, const char* name, const F& f) {
+    std::vector<T> array(SIZE);
+    long evaluated = 0;
+
+    sweep.annotate(0.0, SIZE * sizeof(T));
+    double direct_time = sweep.run(std::string(name) + " direct", SIZE, 1, [&] {
+        f(array.data(), 0, SIZE, SIZE);
+    }).stats.median;
+    double sampled_time = sweep.run(std::string(name) + " sampled", SIZE, 1, [&] {
+        evaluated = sample_period(f, array.data(), SIZE);
+    }).stats.median;
+
+    // odd sizes and n % 4 != 0 take the other code paths
+    bool same = true;
+    for (long n : {4L, 5L, 6L, 7L, 1000L, 1001L, 1002L, 1003L, static_cast<long>(SIZE)})
+        if (!std::is_same<F, Cos2Pi>::value || n % 4 == 0)
+            same = same && identical<T>(f, n);
+
+    std::cout << name << ": direct " << direct_time << " sec, sampled " << sampled_time << " sec, speedup "
+              << direct_time / sampled_time << ", evaluations " << SIZE / static_cast<double>(evaluated)
+              << "x fewer, " << (same ? "bit-identical" : "MISMATCH") << std::endl;
+}
+
+
+int main() {
+    Sweep sweep("lab1 bench_sampler");
+    run<float>(sweep, "sin float", Sin2Pi());
+    run<double>(sweep, "sin double", Sin2Pi());
+    run<bfloat16>(sweep, "sin bfloat16", Sin2Pi());
+    run<_Float16>(sweep, "sin float16", Sin2Pi());
+    run<float>(sweep, "cos float", Cos2Pi());
+    run<double>(sweep, "cos double", Cos2Pi());
+    sweep.save();
+    return 0;
+}
@@ -0,0 +1,82 @@
+#include <iostream>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <limits>
+#include "sin_simd.h"
+#include "bench.h"
+
+const int SIZE = 10000000;
+
+
+// the original fill loop from main.cpp
+template <typename Type>
+void scalar_fill(Type* array, int size) {
+    for (int i = 0; i < size; i++) {
+        Type x = static_cast<Type>(i) / size;
+        array[i] = static_cast<Type>(std::sin(2 * M_PI * x));
+    }
+}
+
+// sin(2*pi*i/n) in long double; the argument is reduced exactly on the
+// integer index first, otherwise the reference itself is off near the zeros
+long double reference_sin(long i, long n) {
+    const long double two_pi = 6.283185307179586476925286766559L;
+    long q = (4 * i + n / 2) / n;
+    long double t = static_cast<long double>(4 * i - q * n) / (4 * n);
+    long double v = (q & 1) ? std::cos(two_pi * t) : std::sin(two_pi * t);
+    return (q & 2) ? -v : v;
+}
+
+// max error in units in the last place of Type
+template <typename Type>
+double max_ulp_error(const std::vector<Type>& array) {
+    long n = array.size();
+    double worst = 0.0;
+    for (long i = 0; i < n; i++) {
+        long double ref = reference_sin(i, n);
+        long double mag = std::fabs(ref);
+        if (mag < std::numeric_limits<Type>::min())
+            mag = std::numeric_limits<Type>::min();
+        long double ulp = std::ldexp(1.0L, std::ilogb(mag) - std::numeric_limits<Type>::digits + 1);
+        double err = static_cast<double>(std::fabs(array[i] - ref) / ulp);
+        if (err > worst)
+            worst = err;
+    }
+    return worst;
+}
+
+template <typename Type>
+void run(Sweep& sweep, const char* type_name) {
+    std::vector<Type> array(SIZE);
+    std::vector<SimdIsa> paths = {SimdIsa::Scalar, SimdIsa::SSE41, SimdIsa::AVX2, SimdIsa::AVX512};
+
+    sweep.annotate(0.0, SIZE * sizeof(Type));
+    const std::string type(type_name);
+    double scalar_time = sweep.run(type + " std::sin loop", SIZE, 1, [&] {
+        scalar_fill(array.data(), SIZE);
+    }).stats.median;
+    std::cout << type_name << " std::sin loop: " << scalar_time << " sec, max error "
+              << max_ulp_error(array) << " ulp" << std::endl;
+
+    for (SimdIsa isa : paths) {
+        if (isa > detect_simd_isa())
+            continue;
+        double runtime = sweep.run(type + " " + simd_isa_name(isa), SIZE, 1, [&] {
+            sin_2pi_fill(isa, array.data(), 0, SIZE, SIZE);
+        }).stats.median;
+        std::cout << type_name << " " << simd_isa_name(isa) << ": " << runtime << " sec, speedup "
+                  << scalar_time / runtime << ", max error " << max_ulp_error(array) << " ulp" << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+
+int main() {
+    std::cout << "Detected: " << simd_isa_name(detect_simd_isa()) << std::endl << std::endl;
+    Sweep sweep("lab1 bench_sin");
+    run<float>(sweep, "float");
+    run<double>(sweep, "double");
+    sweep.save();
+    return 0;
+}
@@ -1,23 +1,195 @@
 #include <iostream>
 #include <cmath>
-
-#ifdef DOUBLE_PRECISION
-using Type = double;
-#else
-using Type = float;
-#endif
+#include <cstring>
+#include <cstdlib>
+#include <string>
+#include <algorithm>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <sys/resource.h>
+#include "sin_simd.h"
+#include "reduce.h"
+#include "precision.h"
+#include "perf_counters.h"
+#include "bench.h"
 
 const int SIZE = 10000000;
 
-int main() {
-    Type* array = new Type[SIZE];
-    for (int i = 0; i < SIZE; i++) {
-        Type x = static_cast<Type>(i) / SIZE;
-        array[i] = static_cast<Type>(std::sin(2 * M_PI * x));
+// bytes per block; one block stays in L1 between generation and reduction
+const int BLOCK_BYTES = 16 * 1024;
+
+
+// fill the whole array, then sum it; only a quarter of the period is
+// evaluated, the rest is mirrored (bit-identical to a full fill)
+template <typename P>
+typename P::accum sum_materialized(long size, SumStrategy strategy) {
+    using Storage = typename P::storage;
+    Storage* array = new Storage[size];
+    sample_period(Sin2Pi(), array, size);
+    typename P::accum sum = reduce_sum<typename P::accum>(strategy, array, size);
+    delete[] array;
+    return sum;
+}
+
+// generate and sum one cache-sized block at a time over [first, last) of
+// the period; block sums are combined with compensation so the strategy's
+// accuracy carries over to the total (with the naive strategy both modes
+// give bit-identical sums)
+template <typename P>
+typename P::accum stream_range(long first, long last, long size, SumStrategy strategy) {
+    using Storage = typename P::storage;
+    using Accum = typename P::accum;
+    const long block_size = BLOCK_BYTES / sizeof(Storage);
+    Storage block[BLOCK_BYTES / sizeof(Storage)];
+    Accum sum = 0, comp = 0;
+    for (long begin = first; begin < last; begin += block_size) {
+        long count = std::min(block_size, last - begin);
+        sin_2pi_fill(block, begin, count, size);
+        if (strategy == SumStrategy::Naive) {
+            for (long i = 0; i < count; i++)
+                sum += static_cast<Accum>(block[i]);
+        } else {
+            reduce_detail::neumaier_add(sum, comp, reduce_sum<Accum>(strategy, block, count));
+        }
+    }
+    return sum + comp;
+}
+
+// A block is far below TREE_MIN_CHUNK, so reduce_sum would run tree as
+// pairwise; instead each worker streams its own contiguous range with
+// pairwise blocks and the partials are combined in the same fixed tree
+// order as reduce_sum's tree.
+template <typename P>
+typename P::accum sum_streaming(long size, SumStrategy strategy) {
+    using Accum = typename P::accum;
+    if (strategy != SumStrategy::Tree)
+        return stream_range<P>(0, size, size, strategy);
+
+    long threads = std::min<long>(std::max(1u, std::thread::hardware_concurrency()),
+                                  std::max(1L, size / reduce_detail::TREE_MIN_CHUNK));
+    std::vector<Accum> partial(threads);
+    std::vector<std::thread> workers;
+    long chunk = size / threads;
+    for (long k = 0; k < threads; k++) {
+        long begin = k * chunk;
+        long end = k == threads - 1 ? size : begin + chunk;
+        workers.emplace_back([&partial, k, begin, end, size] {
+            partial[k] = stream_range<P>(begin, end, size, SumStrategy::Pairwise);
+        });
     }
-    Type sum = 0;
-    for (int i = 0; i < SIZE; i++)
-        sum += array[i];
-    std::cout << sum << std::endl;
+    for (auto& worker : workers)
+        worker.join();
+    for (long stride = 1; stride < threads; stride *= 2)
+        for (long k = 0; k + stride < threads; k += 2 * stride)
+            partial[k] += partial[k + stride];
+    return partial[0];
+}
+
+// Every element at most this many, a uniform stride beyond: the check calls
+// the long double sin once per sampled element.
+const long STORAGE_CHECK_MAX = 1 << 24;
+
+// Max and RMS of |stored - sin(2*pi*i/n)| against a long double reference,
+// i.e. the kernel plus storage rounding error the mirrored, exactly
+// cancelling sum cannot show. Run outside the timed region.
+template <typename P>
+void storage_error(long size, double& max_error, double& rms_error) {
+    using Storage = typename P::storage;
+    const long stride = std::max(1L, size / STORAGE_CHECK_MAX);
+    const long block_size = BLOCK_BYTES / sizeof(Storage);
+    const long double two_pi = 2 * std::acos(-1.0L);
+    Storage block[BLOCK_BYTES / sizeof(Storage)];
+    long double sum_sq = 0;
+    long samples = 0;
+    max_error = 0.0;
+    for (long begin = 0; begin < size; begin += stride == 1 ? block_size : stride) {
+        long count = stride == 1 ? std::min(block_size, size - begin) : 1;
+        sin_2pi_fill(block, begin, count, size);
+        for (long k = 0; k < count; k++) {
+            long double exact = std::sin(two_pi * (begin + k) / size);
+            long double error = std::fabs(static_cast<long double>(static_cast<double>(block[k])) - exact);
+            max_error = std::max(max_error, static_cast<double>(error));
+            sum_sq += error * error;
+            samples++;
+        }
+    }
+    rms_error = static_cast<double>(std::sqrt(sum_sq / samples));
+}
+
+long peak_rss_kb() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+
+template <typename P>
+void run(Sweep& sweep, const char* name, bool streaming, long size, SumStrategy strategy) {
+    using Storage = typename P::storage;
+
+    // inherited, so the reduce worker threads are counted too
+    ThreadCounters counters(true);
+    typename P::accum sum = 0;
+    int threads = strategy == SumStrategy::Tree ? std::max(1u, std::thread::hardware_concurrency()) : 1;
+    sweep.annotate(0.0, size * sizeof(Storage));
+    double runtime = sweep.run(std::string(name) + " " + sum_strategy_name(strategy), size, threads, [&] {
+        sum = streaming ? sum_streaming<P>(size, strategy) : sum_materialized<P>(size, strategy);
+    }, "", counters).stats.median;
+
+    // sin(2*pi*i/n) over a full period sums to exactly 0, so |sum| is the
+    // reduction error; the stored values are mirrored and cancel, so their own
+    // error is measured separately per element
+    double value = static_cast<double>(sum);
+    double max_error, rms_error;
+    storage_error<P>(size, max_error, rms_error);
+    std::cout << name << ": sum " << value << ", sum error " << std::fabs(value) << ", storage error max "
+              << max_error << " rms " << rms_error << std::endl;
+    std::cout << "Time: " << runtime << " sec, " << size * sizeof(Storage) / runtime / 1e9 << " GB/s" << std::endl;
+}
+
+
+// usage: sin [materialized|streaming] [size] [naive|multi|pairwise|neumaier|tree] [precision|all]
+int main(int argc, char** argv) {
+    bool streaming = argc > 1 && std::strcmp(argv[1], "streaming") == 0;
+    long size = argc > 2 ? std::atol(argv[2]) : SIZE;
+    SumStrategy strategy = SumStrategy::Naive;
+    const char* precision = argc > 4 ? argv[4] : "float/float";
+    bool all = std::strcmp(precision, "all") == 0;
+
+    int matched = 0;
+    for_each_precision([&](const char* name, auto) { matched += all || std::strcmp(name, precision) == 0; });
+
+    if ((argc > 1 && !streaming && std::strcmp(argv[1], "materialized") != 0) ||
+        (argc > 3 && !parse_sum_strategy(argv[3], strategy)) || matched == 0) {
+        std::cerr << "usage: " << argv[0] << " [materialized|streaming] [size] [naive|multi|pairwise|neumaier|tree]"
+                  << " [float/float|float/double|double/double|bfloat16/float|float16/float|all]" << std::endl;
+        return 1;
+    }
+
+    // the float kernel reduces 4 * index in int32
+    bool too_large = false;
+    for_each_precision([&](const char* name, auto policy) {
+        using Storage = typename decltype(policy)::storage;
+        if ((all || std::strcmp(name, precision) == 0) && !std::is_same<Storage, double>::value && size > SIN_FLOAT_MAX_N)
+            too_large = true;
+    });
+    if (size <= 0 || too_large) {
+        std::cerr << "size must be in 1.." << SIN_FLOAT_MAX_N << " for float-computed precisions"
+                  << " (double/double has no such limit)" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Mode: " << (streaming ? "streaming" : "materialized") << ", size " << size
+              << ", sum " << sum_strategy_name(strategy) << std::endl << std::endl;
+
+    Sweep sweep(streaming ? "lab1 streaming" : "lab1 materialized");
+    for_each_precision([&](const char* name, auto policy) {
+        if (all || std::strcmp(name, precision) == 0)
+            run<decltype(policy)>(sweep, name, streaming, size, strategy);
+    });
+
+    std::cout << std::endl << "Peak RSS: " << peak_rss_kb() / 1024.0 << " MB" << std::endl;
+    sweep.save();
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+// Samples one period of a function at x = i/n, i in [0, n), evaluating only
+// the part that its declared symmetries do not determine and filling the
+// rest with reflections. The function type declares its traits as
+//
+//   static const unsigned symmetry = Periodic | Odd | QuarterWave;
+//
+// and evaluates batches of indices via
+//
+//   void operator()(T* out, long begin, long count, long n) const;
+//
+// Traits (x in periods):
+//   Periodic     f(x + 1) = f(x); required, without it nothing is reused
+//   Even         f(-x) = f(x),  so out[n - i] = out[i]
+//   Odd          f(-x) = -f(x), so out[n - i] = -out[i]
+//   QuarterWave  f(1/2 - x) = f(x), so out[n/2 - i] = out[i] (n even)
+//
+// Sine is Periodic | Odd | QuarterWave and needs about n/4 evaluations.
+// Reflections copy bits (negation flips the sign bit), so the result is
+// bit-identical to a full evaluation whenever the evaluator itself is
+// exactly symmetric, as sin_2pi_fill is.
+
+enum Symmetry : unsigned {
+    Periodic = 1,
+    Even = 2,
+    Odd = 4,
+    QuarterWave = 8
+};
+
+namespace sampler_detail {
+
+const int LANES = 8;
+
+template <int Bytes>
+struct Bits;
+
+template <>
+struct Bits<2> {
+    using type = uint16_t;
+};
+
+template <>
+struct Bits<4> {
+    using type = uint32_t;
+};
+
+template <>
+struct Bits<8> {
+    using type = uint64_t;
+};
+
+// dst[-1 - k] = src[k] for k in [0, count), optionally with the sign bit
+// flipped. Whole vectors are reversed in registers with __builtin_shuffle.
+template <typename T>
+void reverse_copy(T* dst_end, const T* src, long count, bool negate) {
+    using U = typename Bits<sizeof(T)>::type;
+    typedef U vec __attribute__((vector_size(LANES * sizeof(U))));
+    const U sign = negate ? U(1) << (8 * sizeof(U) - 1) : U(0);
+    const vec reversed = {7, 6, 5, 4, 3, 2, 1, 0};
+
+    long k = 0;
+    for (; k + LANES <= count; k += LANES) {
+        vec v;
+        std::memcpy(&v, src + k, sizeof(v));
+        v = __builtin_shuffle(v, reversed) ^ sign;
+        std::memcpy(dst_end - k - LANES, &v, sizeof(v));
+    }
+    for (int j = 0; j < LANES && k + j < count; j++) {
+        U v;
+        std::memcpy(&v, src + k + j, sizeof(v));
+        v ^= sign;
+        std::memcpy(dst_end - k - j - 1, &v, sizeof(v));
+    }
+}
+
+// Fills [begin, begin + length), a range that is its own mirror image under
+// quarter-wave symmetry, from its lower half.
+template <typename T, typename F>
+long mirror_fill(const F& f, T* out, long begin, long length, long n) {
+    long lower = (length + 1) / 2;
+    f(out + begin, begin, lower, n);
+    reverse_copy(out + begin + length, out + begin, length - lower, false);
+    return lower;
+}
+
+} // namespace sampler_detail
+
+
+// Writes f at i/n for i in [0, n) into out and returns the number of
+// indices that were actually evaluated.
+template <typename T, typename F>
+long sample_period(const F& f, T* out, long n) {
+    using namespace sampler_detail;
+    const unsigned symmetry = F::symmetry;
+    const bool mirrored = (symmetry & (Even | Odd)) != 0;
+    const bool quarter = (symmetry & QuarterWave) && n % 2 == 0;
+
+    if (!(symmetry & Periodic) || n < 4) {
+        f(out, 0, n, n);
+        return n;
+    }
+
+    // under quarter-wave symmetry [0, n/2] maps onto itself by i -> n/2 - i
+    long half = n / 2;
+    long evaluated;
+    if (quarter)
+        evaluated = mirror_fill(f, out, 0, half + 1, n);
+    else {
+        f(out, 0, half + 1, n);
+        evaluated = half + 1;
+    }
+
+    if (mirrored) {
+        // out[n - i] = +-out[i] for i in [1, n - half)
+        reverse_copy(out + n, out + 1, n - half - 1, (symmetry & Odd) != 0);
+    } else if (quarter) {
+        // (n/2, n) maps onto itself by i -> 3n/2 - i
+        evaluated += mirror_fill(f, out, half + 1, n - half - 1, n);
+    } else {
+        f(out + half + 1, half + 1, n - half - 1, n);
+        evaluated += n - half - 1;
+    }
+    return evaluated;
+}
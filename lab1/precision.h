@@ -0,0 +1,30 @@
+#pragma once
+
+#include "bfloat16.h"
+
+// A precision policy pairs the element type the array is stored in with the
+// type the reduction accumulates in. Narrow storage halves (or quarters) the
+// memory traffic; a wide accumulator keeps the rounding error of the sum
+// from growing with the array size.
+template <typename Storage, typename Accum>
+struct Precision {
+    using storage = Storage;
+    using accum = Accum;
+};
+
+using FloatFloat = Precision<float, float>;
+using FloatDouble = Precision<float, double>;
+using DoubleDouble = Precision<double, double>;
+using BFloat16Float = Precision<bfloat16, float>;
+using Float16Float = Precision<_Float16, float>;
+
+// Calls f(name, Policy()) for every policy above, in order. Lets one binary
+// instantiate and select all of them at runtime.
+template <typename F>
+void for_each_precision(F f) {
+    f("float/float", FloatFloat());
+    f("float/double", FloatDouble());
+    f("double/double", DoubleDouble());
+    f("bfloat16/float", BFloat16Float());
+    f("float16/float", Float16Float());
+}
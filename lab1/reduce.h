@@ -0,0 +1,221 @@
+#pragma once
+
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "bfloat16.h"
+
+// Summation strategies for the lab1 reduction. All of them are templated on
+// the storage type T and the accumulator type Acc, so e.g. a float array can
+// be summed in double.
+//
+//   naive     - the original `sum += array[i]` loop, error grows as O(n)
+//   multi     - 4 independent vector accumulators, no loop-carried chain
+//   pairwise  - recursive halving over multi-sized leaves, error O(log n)
+//   neumaier  - compensated (improved Kahan) summation in vector lanes
+//   tree      - pairwise per thread chunk, partials combined as a binary tree
+
+enum class SumStrategy {
+    Naive,
+    Multi,
+    Pairwise,
+    Neumaier,
+    Tree
+};
+
+inline const char* sum_strategy_name(SumStrategy strategy) {
+    switch (strategy) {
+        case SumStrategy::Multi: return "multi";
+        case SumStrategy::Pairwise: return "pairwise";
+        case SumStrategy::Neumaier: return "neumaier";
+        case SumStrategy::Tree: return "tree";
+        default: return "naive";
+    }
+}
+
+inline bool parse_sum_strategy(const char* name, SumStrategy& strategy) {
+    for (SumStrategy s : {SumStrategy::Naive, SumStrategy::Multi, SumStrategy::Pairwise,
+                          SumStrategy::Neumaier, SumStrategy::Tree}) {
+        if (std::strcmp(name, sum_strategy_name(s)) == 0) {
+            strategy = s;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+namespace reduce_detail {
+
+const int LANES = 8;
+const int PAIRWISE_LEAF = 256;
+const long TREE_MIN_CHUNK = 1 << 16;
+
+template <typename Acc>
+struct Vec {
+    typedef Acc type __attribute__((vector_size(LANES * sizeof(Acc))));
+};
+
+// by reference: returning wide vectors by value would depend on -mavx
+template <typename V, typename T>
+inline void load(V& out, const T* data) {
+    typedef T raw __attribute__((vector_size(LANES * sizeof(T))));
+    raw v;
+    std::memcpy(&v, data, sizeof(v));
+    out = __builtin_convertvector(v, V);
+}
+
+// bfloat16 widens to float by shifting its bits into the upper half
+template <typename V>
+inline void load(V& out, const bfloat16* data) {
+    typedef uint16_t raw __attribute__((vector_size(LANES * sizeof(uint16_t))));
+    typedef uint32_t wide __attribute__((vector_size(LANES * sizeof(uint32_t))));
+    typedef float real __attribute__((vector_size(LANES * sizeof(float))));
+    raw v;
+    std::memcpy(&v, data, sizeof(v));
+    wide w = __builtin_convertvector(v, wide) << 16;
+    real x;
+    std::memcpy(&x, &w, sizeof(x));
+    out = __builtin_convertvector(x, V);
+}
+
+// _Float16 widens with integer ops as well, so the reduction does not need
+// F16C: shifting exponent and mantissa into float position and scaling by
+// 2^112 rebiases the exponent and handles subnormals; inf/NaN are patched
+template <typename V>
+inline void load(V& out, const _Float16* data) {
+    typedef uint16_t raw __attribute__((vector_size(LANES * sizeof(uint16_t))));
+    typedef uint32_t wide __attribute__((vector_size(LANES * sizeof(uint32_t))));
+    typedef float real __attribute__((vector_size(LANES * sizeof(float))));
+    raw v;
+    std::memcpy(&v, data, sizeof(v));
+    wide h = __builtin_convertvector(v, wide);
+    wide magnitude = (h & 0x7fffu) << 13;
+    real x;
+    std::memcpy(&x, &magnitude, sizeof(x));
+    x *= 0x1p112f;
+    wide w;
+    std::memcpy(&w, &x, sizeof(w));
+    w |= (h & 0x7c00u) == 0x7c00u ? 0x7f800000u : 0u;
+    w |= (h & 0x8000u) << 16;
+    std::memcpy(&x, &w, sizeof(x));
+    out = __builtin_convertvector(x, V);
+}
+
+template <typename Acc, typename T>
+Acc sum_naive(const T* data, long n) {
+    Acc sum = 0;
+    for (long i = 0; i < n; i++)
+        sum += static_cast<Acc>(data[i]);
+    return sum;
+}
+
+template <typename Acc, typename T>
+Acc sum_multi(const T* data, long n) {
+    using V = typename Vec<Acc>::type;
+    V acc0 = {}, acc1 = {}, acc2 = {}, acc3 = {};
+    V x0, x1, x2, x3;
+    long i = 0;
+    for (; i + 4 * LANES <= n; i += 4 * LANES) {
+        load(x0, data + i);
+        load(x1, data + i + LANES);
+        load(x2, data + i + 2 * LANES);
+        load(x3, data + i + 3 * LANES);
+        acc0 += x0;
+        acc1 += x1;
+        acc2 += x2;
+        acc3 += x3;
+    }
+    V acc = (acc0 + acc1) + (acc2 + acc3);
+    Acc sum = 0;
+    for (int l = 0; l < LANES; l++)
+        sum += acc[l];
+    for (; i < n; i++)
+        sum += static_cast<Acc>(data[i]);
+    return sum;
+}
+
+template <typename Acc, typename T>
+Acc sum_pairwise(const T* data, long n) {
+    if (n <= PAIRWISE_LEAF)
+        return sum_multi<Acc>(data, n);
+    long half = n / 2;
+    return sum_pairwise<Acc>(data, half) + sum_pairwise<Acc>(data + half, n - half);
+}
+
+template <typename Acc>
+inline void neumaier_add(Acc& sum, Acc& comp, Acc x) {
+    Acc t = sum + x;
+    if ((sum < 0 ? -sum : sum) >= (x < 0 ? -x : x))
+        comp += (sum - t) + x;
+    else
+        comp += (x - t) + sum;
+    sum = t;
+}
+
+template <typename Acc, typename T>
+Acc sum_neumaier(const T* data, long n) {
+    using V = typename Vec<Acc>::type;
+    V sum = {}, comp = {}, x;
+    long i = 0;
+    for (; i + LANES <= n; i += LANES) {
+        load(x, data + i);
+        V t = sum + x;
+        V abs_sum = sum < 0 ? -sum : sum;
+        V abs_x = x < 0 ? -x : x;
+        comp += abs_sum >= abs_x ? (sum - t) + x : (x - t) + sum;
+        sum = t;
+    }
+    Acc s = 0, c = 0;
+    for (int l = 0; l < LANES; l++) {
+        neumaier_add(s, c, sum[l]);
+        neumaier_add(s, c, comp[l]);
+    }
+    for (; i < n; i++)
+        neumaier_add(s, c, static_cast<Acc>(data[i]));
+    return s + c;
+}
+
+template <typename Acc, typename T>
+Acc sum_tree(const T* data, long n, int threads) {
+    long max_threads = n / TREE_MIN_CHUNK;
+    if (threads > max_threads)
+        threads = max_threads > 0 ? static_cast<int>(max_threads) : 1;
+    if (threads <= 1)
+        return sum_pairwise<Acc>(data, n);
+
+    std::vector<Acc> partial(threads);
+    std::vector<std::thread> workers;
+    long chunk = n / threads;
+    for (int k = 0; k < threads; k++) {
+        long begin = k * chunk;
+        long end = k == threads - 1 ? n : begin + chunk;
+        workers.emplace_back([&partial, data, k, begin, end] {
+            partial[k] = sum_pairwise<Acc>(data + begin, end - begin);
+        });
+    }
+    for (auto& worker : workers)
+        worker.join();
+
+    // fixed combination order, so the result does not depend on timing
+    for (int stride = 1; stride < threads; stride *= 2)
+        for (int k = 0; k + stride < threads; k += 2 * stride)
+            partial[k] += partial[k + stride];
+    return partial[0];
+}
+
+} // namespace reduce_detail
+
+
+// Sum of data[0..n) with the given strategy. `threads` is only used by the
+// tree strategy, which falls back to pairwise for small inputs.
+template <typename Acc, typename T>
+Acc reduce_sum(SumStrategy strategy, const T* data, long n, int threads = std::thread::hardware_concurrency()) {
+    switch (strategy) {
+        case SumStrategy::Multi: return reduce_detail::sum_multi<Acc>(data, n);
+        case SumStrategy::Pairwise: return reduce_detail::sum_pairwise<Acc>(data, n);
+        case SumStrategy::Neumaier: return reduce_detail::sum_neumaier<Acc>(data, n);
+        case SumStrategy::Tree: return reduce_detail::sum_tree<Acc>(data, n, threads);
+        default: return reduce_detail::sum_naive<Acc>(data, n);
+    }
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <thread>
+#include <vector>
+
+// sin(2*pi*i/n) from the angle-addition recurrence instead of one sine call
+// per element. Written in Reinsch's form, which stays accurate for small
+// steps where the textbook s[k+1] = 2*cos(h)*s[k] - s[k-1] loses the step
+// size to cancellation:
+//
+//   s[k+1] = s[k] + d[k]
+//   d[k+1] = d[k] + lambda * s[k+1],   lambda = -4 * sin^2(h/2)
+//
+// i.e. one add and one FMA per element, always carried out in double and
+// rounded once on store. The 8 vector lanes run 8 interleaved recurrences
+// with step h = 8 * 2*pi/n, so each step stores 8 consecutive values. The
+// range is cut into segments that are seeded independently from long double
+// sin/cos: rounding error cannot carry over from one segment to the next
+// and segments can run on separate threads.
+
+namespace recurrence_detail {
+
+const int LANES = 8;
+const long double TWO_PI = 6.283185307179586476925286766559L;
+
+typedef double vec __attribute__((vector_size(LANES * sizeof(double))));
+
+// A priori bound on the absolute error after `steps` vector steps: every
+// step rounds s (|s| <= 1) and d, and an error in d reaches s amplified by
+// the number of remaining steps times the angle step. Rounding the result
+// to T adds half an ulp of 1.
+template <typename T>
+double error_bound(long steps, double h) {
+    const double u = std::numeric_limits<double>::epsilon() / 2;
+    return 2 * u * steps * (1 + steps * h) + std::numeric_limits<T>::epsilon() / 2;
+}
+
+// Seeds for all lanes come from one sin/cos pair per segment, rotated by
+// per-lane angles that are tabulated once per fill.
+struct Seeds {
+    long double sin_h2;
+    long double cos_l[LANES], sin_l[LANES];
+    long double cos_lh[LANES], sin_lh[LANES];
+
+    explicit Seeds(long n) {
+        long double step = TWO_PI / n;
+        long double h = step * LANES;
+        sin_h2 = std::sin(h / 2);
+        for (int l = 0; l < LANES; l++) {
+            cos_l[l] = std::cos(step * l);
+            sin_l[l] = std::sin(step * l);
+            cos_lh[l] = std::cos(step * l + h / 2);
+            sin_lh[l] = std::sin(step * l + h / 2);
+        }
+    }
+};
+
+template <typename T>
+void fill_segment(T* out, long begin, long count, long n, const Seeds& seeds) {
+    long double angle = TWO_PI * (begin % n) / n;
+    long double sa = std::sin(angle), ca = std::cos(angle);
+
+    vec s, d;
+    for (int l = 0; l < LANES; l++) {
+        s[l] = static_cast<double>(sa * seeds.cos_l[l] + ca * seeds.sin_l[l]);
+        // sin(a + h) - sin(a) = 2 * cos(a + h/2) * sin(h/2), no cancellation
+        d[l] = static_cast<double>(2 * seeds.sin_h2 * (ca * seeds.cos_lh[l] - sa * seeds.sin_lh[l]));
+    }
+    const double lambda = static_cast<double>(-4 * seeds.sin_h2 * seeds.sin_h2);
+
+    typedef T stored __attribute__((vector_size(LANES * sizeof(T))));
+    stored v;
+    long k = 0;
+    for (; k + LANES <= count; k += LANES) {
+        v = __builtin_convertvector(s, stored);
+        std::memcpy(out + k, &v, sizeof(v));
+        s += d;
+        d += lambda * s;
+    }
+    v = __builtin_convertvector(s, stored);
+    std::memcpy(out + k, &v, (count - k) * sizeof(T));
+}
+
+} // namespace recurrence_detail
+
+
+// Longest segment, in elements, whose a priori error bound stays within
+// `tolerance` (absolute). Falls back to one vector step per segment, which
+// is just the long double seeds rounded to T.
+template <typename T>
+long recurrence_segment_length(long n, double tolerance) {
+    using namespace recurrence_detail;
+    const double h = static_cast<double>(TWO_PI) * LANES / n;
+    long steps = 1;
+    while (steps * LANES < n && error_bound<T>(2 * steps, h) <= tolerance)
+        steps *= 2;
+    return steps * LANES;
+}
+
+// out[k] = sin(2*pi*(begin + k)/n) for k in [0, count), reseeding every
+// recurrence_segment_length<T>(n, tolerance) elements, or more often if
+// that is needed to give each of `threads` std::threads a segment.
+template <typename T>
+void sin_2pi_recurrence_fill(T* out, long begin, long count, long n, double tolerance, int threads = 1) {
+    const int lanes = recurrence_detail::LANES;
+    long segment = recurrence_segment_length<T>(n, tolerance);
+    // a loose tolerance must not leave threads without a segment
+    long per_thread = (count / std::max(threads, 1) + lanes - 1) / lanes * lanes;
+    if (threads > 1 && per_thread >= lanes && per_thread < segment)
+        segment = per_thread;
+    const long segments = (count + segment - 1) / segment;
+    if (threads > segments)
+        threads = segments > 0 ? static_cast<int>(segments) : 1;
+
+    const recurrence_detail::Seeds seeds(n);
+
+    auto work = [=, &seeds](long first, long last) {
+        for (long s = first; s < last; s++) {
+            long offset = s * segment;
+            long length = std::min(segment, count - offset);
+            recurrence_detail::fill_segment(out + offset, begin + offset, length, n, seeds);
+        }
+    };
+
+    if (threads <= 1) {
+        work(0, segments);
+        return;
+    }
+    std::vector<std::thread> workers;
+    long segments_per_thread = segments / threads;
+    for (int t = 0; t < threads; t++) {
+        long first = t * segments_per_thread;
+        long last = t == threads - 1 ? segments : first + segments_per_thread;
+        workers.emplace_back(work, first, last);
+    }
+    for (auto& worker : workers)
+        worker.join();
+}
@@ -0,0 +1,85 @@
+#include <stdexcept>
+#include <type_traits>
+#include "sin_simd.h"
+#include "sin_simd_kernel.h"
+
+void sin_2pi_fill_sse(float* out, long begin, long count, long n);
+void sin_2pi_fill_sse(double* out, long begin, long count, long n);
+void sin_2pi_fill_sse(bfloat16* out, long begin, long count, long n);
+void sin_2pi_fill_sse(_Float16* out, long begin, long count, long n);
+void sin_2pi_fill_avx2(float* out, long begin, long count, long n);
+void sin_2pi_fill_avx2(double* out, long begin, long count, long n);
+void sin_2pi_fill_avx2(bfloat16* out, long begin, long count, long n);
+void sin_2pi_fill_avx2(_Float16* out, long begin, long count, long n);
+void sin_2pi_fill_avx512(float* out, long begin, long count, long n);
+void sin_2pi_fill_avx512(double* out, long begin, long count, long n);
+void sin_2pi_fill_avx512(bfloat16* out, long begin, long count, long n);
+void sin_2pi_fill_avx512(_Float16* out, long begin, long count, long n);
+
+SimdIsa detect_simd_isa() {
+    static const SimdIsa isa = [] {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f"))
+            return SimdIsa::AVX512;
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && __builtin_cpu_supports("f16c"))
+            return SimdIsa::AVX2;
+        if (__builtin_cpu_supports("sse4.1"))
+            return SimdIsa::SSE41;
+        return SimdIsa::Scalar;
+    }();
+    return isa;
+}
+
+const char* simd_isa_name(SimdIsa isa) {
+    switch (isa) {
+        case SimdIsa::SSE41: return "sse4.1";
+        case SimdIsa::AVX2: return "avx2";
+        case SimdIsa::AVX512: return "avx512";
+        default: return "scalar";
+    }
+}
+
+
+template <typename T>
+static void fill(SimdIsa isa, T* out, long begin, long count, long n) {
+    if (!std::is_same<T, double>::value && n > SIN_FLOAT_MAX_N)
+        throw std::invalid_argument("sin_2pi_fill: n above SIN_FLOAT_MAX_N for float-computed output");
+    switch (isa) {
+        case SimdIsa::SSE41: sin_2pi_fill_sse(out, begin, count, n); break;
+        case SimdIsa::AVX2: sin_2pi_fill_avx2(out, begin, count, n); break;
+        case SimdIsa::AVX512: sin_2pi_fill_avx512(out, begin, count, n); break;
+        default: sin_simd_detail::sin_2pi_fill<T, 1>(out, begin, count, n); break;
+    }
+}
+
+void sin_2pi_fill(SimdIsa isa, float* out, long begin, long count, long n) {
+    fill(isa, out, begin, count, n);
+}
+
+void sin_2pi_fill(SimdIsa isa, double* out, long begin, long count, long n) {
+    fill(isa, out, begin, count, n);
+}
+
+void sin_2pi_fill(SimdIsa isa, bfloat16* out, long begin, long count, long n) {
+    fill(isa, out, begin, count, n);
+}
+
+void sin_2pi_fill(SimdIsa isa, _Float16* out, long begin, long count, long n) {
+    fill(isa, out, begin, count, n);
+}
+
+void sin_2pi_fill(float* out, long begin, long count, long n) {
+    fill(detect_simd_isa(), out, begin, count, n);
+}
+
+void sin_2pi_fill(double* out, long begin, long count, long n) {
+    fill(detect_simd_isa(), out, begin, count, n);
+}
+
+void sin_2pi_fill(bfloat16* out, long begin, long count, long n) {
+    fill(detect_simd_isa(), out, begin, count, n);
+}
+
+void sin_2pi_fill(_Float16* out, long begin, long count, long n) {
+    fill(detect_simd_isa(), out, begin, count, n);
+}
@@ -0,0 +1,17 @@
+#include "sin_simd_kernel.h"
+
+void sin_2pi_fill_avx2(float* out, long begin, long count, long n) {
+    sin_simd_detail::sin_2pi_fill<float, 8>(out, begin, count, n);
+}
+
+void sin_2pi_fill_avx2(double* out, long begin, long count, long n) {
+    sin_simd_detail::sin_2pi_fill<double, 4>(out, begin, count, n);
+}
+
+void sin_2pi_fill_avx2(bfloat16* out, long begin, long count, long n) {
+    sin_simd_detail::sin_2pi_fill<bfloat16, 8>(out, begin, count, n);
+}
+
+void sin_2pi_fill_avx2(_Float16* out, long begin, long count, long n) {
+    sin_simd_detail::sin_2pi_fill<_Float16, 8>(out, begin, count, n);
+}
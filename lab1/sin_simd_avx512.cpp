@@ -0,0 +1,17 @@
+#include "sin_simd_kernel.h"
+
+void sin_2pi_fill_avx512(float* out, long begin, long count, long n) {
+    sin_simd_detail::sin_2pi_fill<float, 16>(out, begin, count, n);
+}
+
+void sin_2pi_fill_avx512(double* out, long begin, long count, long n) {
+    sin_simd_detail::sin_2pi_fill<double, 8>(out, begin, count, n);
+}
+
+void sin_2pi_fill_avx512(bfloat16* out, long begin, long count, long n) {
+    sin_simd_detail::sin_2pi_fill<bfloat16, 16>(out, begin, count, n);
+}
+
+void sin_2pi_fill_avx512(_Float16* out, long begin, long count, long n) {
+    sin_simd_detail::sin_2pi_fill<_Float16, 16>(out, begin, count, n);
+}
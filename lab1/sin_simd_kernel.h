@@ -0,0 +1,238 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include "bfloat16.h"
+
+#ifdef __F16C__
+#include <immintrin.h>
+#endif
+
+// Width-generic body of the sin(2*pi*i/n) fill. Every ISA translation unit
+// (sin_simd_sse.cpp, sin_simd_avx2.cpp, ...) includes this header and is
+// compiled with its own -m flags, so the GCC vector types below lower to
+// xmm/ymm/zmm registers there.
+//
+// Range reduction is done on the integer index: 4*i = q*n + r with
+// |r| <= n/2, so the reduced argument r/(4n) is exact up to a single
+// rounding and the quadrant q is never wrong. sin(2*pi*t) and cos(2*pi*t)
+// for |t| <= 1/8 are then plain Taylor polynomials in t.
+//
+// The reduction is symmetric, which periodic_sampler.h relies on: the
+// mirrored indices n/2 - i and n - i land on the same polynomial with t
+// negated (ties |r| = n/2 always go to the even, sine quadrant), and the
+// sign is applied as 0 - v so sin(pi) comes out as +0 like sin(0).
+
+namespace sin_simd_detail {
+
+template <typename T, int N>
+constexpr T poly_coef() {
+    // (2*pi)^N / N!, evaluated in long double and rounded once
+    long double c = 1.0L;
+    for (int k = 1; k <= N; k++)
+        c = c * 6.283185307179586476925286766559L / k;
+    return static_cast<T>(c);
+}
+
+template <typename T, int W>
+struct Vec {
+    typedef T real __attribute__((vector_size(W * sizeof(T))));
+    typedef int index __attribute__((vector_size(W * sizeof(int))));
+};
+
+// 0, 4, 8, ... in every lane, so a vector of 4*i is one broadcast add
+template <typename V, int W>
+inline V lane_offsets() {
+    V v;
+    for (int l = 0; l < W; l++)
+        v[l] = 4 * l;
+    return v;
+}
+
+template <typename R>
+inline R sin_poly(R t, R t2, float) {
+    return t * (poly_coef<float, 1>() - t2 * (poly_coef<float, 3>() - t2 * (poly_coef<float, 5>()
+        - t2 * (poly_coef<float, 7>() - t2 * poly_coef<float, 9>()))));
+}
+
+template <typename R>
+inline R cos_poly(R t2, float) {
+    return 1.0f - t2 * (poly_coef<float, 2>() - t2 * (poly_coef<float, 4>() - t2 * (poly_coef<float, 6>()
+        - t2 * (poly_coef<float, 8>() - t2 * poly_coef<float, 10>()))));
+}
+
+template <typename R>
+inline R sin_poly(R t, R t2, double) {
+    return t * (poly_coef<double, 1>() - t2 * (poly_coef<double, 3>() - t2 * (poly_coef<double, 5>()
+        - t2 * (poly_coef<double, 7>() - t2 * (poly_coef<double, 9>() - t2 * (poly_coef<double, 11>()
+        - t2 * (poly_coef<double, 13>() - t2 * (poly_coef<double, 15>() - t2 * poly_coef<double, 17>()))))))));
+}
+
+template <typename R>
+inline R cos_poly(R t2, double) {
+    return 1.0 - t2 * (poly_coef<double, 2>() - t2 * (poly_coef<double, 4>() - t2 * (poly_coef<double, 6>()
+        - t2 * (poly_coef<double, 8>() - t2 * (poly_coef<double, 10>() - t2 * (poly_coef<double, 12>()
+        - t2 * (poly_coef<double, 14>() - t2 * (poly_coef<double, 16>() - t2 * poly_coef<double, 18>()))))))));
+}
+
+// Reduced argument t in [-1/8, 1/8] plus quadrant flags for one vector of
+// indices. float lanes reduce in int32 (4*i does not fit a float mantissa),
+// double lanes reduce in double, where every integer below 2^53 is exact
+// and no 64-bit integer multiply is needed.
+template <typename T, int W>
+struct Reduced {
+    typename Vec<T, W>::real t;
+    decltype(typename Vec<T, W>::real() < 0) odd;
+    decltype(typename Vec<T, W>::real() < 0) neg;
+};
+
+template <int W>
+inline Reduced<float, W> reduce(long begin, long n, float) {
+    using real = typename Vec<float, W>::real;
+    using index = typename Vec<float, W>::index;
+
+    static const index offsets = lane_offsets<index, W>();
+    index k = offsets + static_cast<int>(4 * begin);
+
+    // q = round(4i/n) from a cheap reciprocal, then fixed up exactly below
+    const int ni = static_cast<int>(n);
+    real kf = __builtin_convertvector(k, real);
+    index q = __builtin_convertvector(kf * (1.0f / static_cast<float>(n)) + 0.5f, index);
+    index r = k - q * ni;
+
+    index hi = (r + r) > ni;
+    r = hi ? r - ni : r;
+    q = hi ? q + 1 : q;
+    index lo = (r + r) <= -ni;
+    r = lo ? r + ni : r;
+    q = lo ? q - 1 : q;
+    index tie = ((r + r) == ni) & ((q & 1) != 0);
+    r = tie ? r - ni : r;
+    q = tie ? q + 1 : q;
+
+    Reduced<float, W> red;
+    red.t = __builtin_convertvector(r, real) / static_cast<float>(4 * n);
+    red.odd = (q & 1) != 0;
+    red.neg = (q & 2) != 0;
+    return red;
+}
+
+template <int W>
+inline Reduced<double, W> reduce(long begin, long n, double) {
+    using real = typename Vec<double, W>::real;
+    using index = typename Vec<double, W>::index;
+
+    static const real offsets = lane_offsets<real, W>();
+    real k = offsets + 4.0 * begin;
+
+    const real nf = real() + static_cast<double>(n);
+    real q = __builtin_convertvector(__builtin_convertvector(k * (1.0 / n) + 0.5, index), real);
+    real r = k - q * nf;
+
+    auto hi = (r + r) > nf;
+    r = hi ? r - nf : r;
+    q = hi ? q + 1.0 : q;
+    auto lo = (r + r) <= -nf;
+    r = lo ? r + nf : r;
+    q = lo ? q - 1.0 : q;
+
+    // q >= 0 here, so truncation is floor
+    real half = q * 0.5;
+    auto tie = ((r + r) == nf) & (half != __builtin_convertvector(__builtin_convertvector(half, index), real));
+    r = tie ? r - nf : r;
+    q = tie ? q + 1.0 : q;
+    half = q * 0.5;
+    real quarter = q * 0.25;
+    real quarter_frac = quarter - __builtin_convertvector(__builtin_convertvector(quarter, index), real);
+
+    Reduced<double, W> red;
+    red.t = r / (4.0 * n);
+    red.odd = half != __builtin_convertvector(__builtin_convertvector(half, index), real);
+    red.neg = quarter_frac >= 0.5;
+    return red;
+}
+
+// One vector of sin(2*pi*(begin + lane)/n) for begin >= 0. float lanes
+// need 4*(begin + W) to fit into int.
+template <typename T, int W>
+inline typename Vec<T, W>::real sin_2pi_block(long begin, long n) {
+    using real = typename Vec<T, W>::real;
+
+    Reduced<T, W> red = reduce<W>(begin, n, T());
+    real t2 = red.t * red.t;
+    real s = sin_poly(red.t, t2, T());
+    real c = cos_poly(t2, T());
+
+    // quadrant 0: sin, 1: cos, 2: -sin, 3: -cos
+    real v = red.odd ? c : s;
+    return red.neg ? T(0) - v : v;
+}
+
+// Narrow storage types are computed in float and converted in registers:
+// _Float16 lowers to vcvtps2ph where -mf16c is on, bfloat16 is rounded to
+// nearest even on the bit pattern (sine values are never NaN).
+template <typename S>
+struct Compute {
+    using type = float;
+};
+
+template <>
+struct Compute<double> {
+    using type = double;
+};
+
+template <typename T, int W>
+inline void store(T* out, const typename Vec<T, W>::real& v, long count) {
+    std::memcpy(out, &v, count * sizeof(T));
+}
+
+template <int W>
+struct NarrowVec {
+    typedef _Float16 half __attribute__((vector_size(W * sizeof(_Float16))));
+    typedef uint16_t bits16 __attribute__((vector_size(W * sizeof(uint16_t))));
+    typedef uint32_t bits32 __attribute__((vector_size(W * sizeof(uint32_t))));
+};
+
+template <typename T, int W>
+inline void store(_Float16* out, const typename Vec<T, W>::real& v, long count) {
+    typename NarrowVec<W>::half h;
+#ifdef __F16C__
+    if (W % 8 == 0) {
+        // GCC 12 scalarizes the generic conversion, so spell out vcvtps2ph
+        for (int k = 0; k < W; k += 8) {
+            __m256 x;
+            std::memcpy(&x, reinterpret_cast<const float*>(&v) + k, sizeof(x));
+            __m128i packed = _mm256_cvtps_ph(x, _MM_FROUND_TO_NEAREST_INT);
+            std::memcpy(reinterpret_cast<_Float16*>(&h) + k, &packed, sizeof(packed));
+        }
+        std::memcpy(out, &h, count * sizeof(_Float16));
+        return;
+    }
+#endif
+    h = __builtin_convertvector(v, typename NarrowVec<W>::half);
+    std::memcpy(out, &h, count * sizeof(_Float16));
+}
+
+template <typename T, int W>
+inline void store(bfloat16* out, const typename Vec<T, W>::real& v, long count) {
+    typename NarrowVec<W>::bits32 u;
+    std::memcpy(&u, &v, sizeof(u));
+    u = (u + 0x7fffu + ((u >> 16) & 1u)) >> 16;
+    typename NarrowVec<W>::bits16 b = __builtin_convertvector(u, typename NarrowVec<W>::bits16);
+    std::memcpy(out, &b, count * sizeof(bfloat16));
+}
+
+template <typename S, int W>
+void sin_2pi_fill(S* out, long begin, long count, long n) {
+    using T = typename Compute<S>::type;
+    long k = 0;
+    for (; k + W <= count; k += W)
+        store<T, W>(out + k, sin_2pi_block<T, W>(begin + k, n), W);
+    if (k < count) {
+        // the tail goes through the same vector code so every element
+        // gets bit-identical treatment regardless of its position
+        store<T, W>(out + k, sin_2pi_block<T, W>(begin + k, n), count - k);
+    }
+}
+
+} // namespace sin_simd_detail
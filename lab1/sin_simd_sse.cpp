@@ -0,0 +1,17 @@
+#include "sin_simd_kernel.h"
+
+void sin_2pi_fill_sse(float* out, long begin, long count, long n) {
+    sin_simd_detail::sin_2pi_fill<float, 4>(out, begin, count, n);
+}
+
+void sin_2pi_fill_sse(double* out, long begin, long count, long n) {
+    sin_simd_detail::sin_2pi_fill<double, 2>(out, begin, count, n);
+}
+
+void sin_2pi_fill_sse(bfloat16* out, long begin, long count, long n) {
+    sin_simd_detail::sin_2pi_fill<bfloat16, 4>(out, begin, count, n);
+}
+
+void sin_2pi_fill_sse(_Float16* out, long begin, long count, long n) {
+    sin_simd_detail::sin_2pi_fill<_Float16, 4>(out, begin, count, n);
+}
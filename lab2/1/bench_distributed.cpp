@@ -0,0 +1,85 @@
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <mpi.h>
+#include <omp.h>
+#include "distributed_gemv.h"
+#include "ij_matrix.h"
+#include "bench.h"
+
+
+// the communication wait of every timed multiply, for bench.h measure()
+struct CommWaitProbe {
+    const DistributedGemv& a;
+    double total = 0.0;
+
+    void start() {}
+    void stop() { total += a.comm_wait(); }
+    std::vector<std::pair<std::string, double>> metrics(int runs) const { return {{"comm_wait", total / runs}}; }
+};
+
+// Median wall time and mean comm wait, each of the slowest rank; y is
+// gathered on rank 0. Every rank does the same number of runs (min_runs),
+// since a run ends in collectives that all ranks must enter.
+void run(long n, int chunks, int rank) {
+    DistributedGemv a(n, n, MPI_COMM_WORLD, chunks);
+    Matrix<double>& block = a.block();
+#pragma omp parallel for
+    for (long i = 0; i < static_cast<long>(block.rows()); i++)
+        for (long j = 0; j < static_cast<long>(block.cols()); j++)
+            block(i, j) = ij_element(a.row_begin() + i, a.col_begin() + j);
+
+    std::vector<double> x(a.col_end() - a.col_begin(), 1.0), y(a.row_end() - a.row_begin());
+    BenchOptions options = BenchOptions::from_env();
+    options.max_runs = options.min_runs;
+    CommWaitProbe wait{a};
+    Stats stats = measure([&] {
+        MPI_Barrier(MPI_COMM_WORLD);  // timed too: the skew the last run left
+        a.multiply(x.data(), y.data());
+    }, options, wait);
+    double times[2] = {stats.median, wait.metrics(stats.runs)[0].second};
+    MPI_Allreduce(MPI_IN_PLACE, times, 2, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+
+    std::vector<double> full;
+    a.gather(y.data(), full);
+    if (rank == 0)
+        std::cout << "chunks " << chunks << ": " << times[0] << " s (median of " << stats.runs << "), "
+                  << 2.0 * n * n / times[0] / 1e9 << " GFLOP/s, comm wait " << times[1] << " s, max rel error "
+                  << ij_max_error(full, n) << std::endl;
+}
+
+
+// usage: mpirun -np N bench_distributed [n] [chunks]
+// Ranks form a near-square grid; OMP_NUM_THREADS sets the threads of each
+// rank. On one box with fewer cores than ranks x threads, Open MPI needs
+// --oversubscribe. chunks = 1 (no overlap) is run first for comparison.
+int main(int argc, char** argv) {
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    if (provided < MPI_THREAD_FUNNELED) {
+        if (rank == 0)
+            std::cerr << "MPI library does not support MPI_THREAD_FUNNELED" << std::endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    long n = argc > 1 ? std::atol(argv[1]) : 16384;
+    int chunks = argc > 2 ? std::atoi(argv[2]) : DIST_CHUNKS;
+
+    int dims[2] = {0, 0};
+    MPI_Dims_create(size, 2, dims);
+    if (rank == 0)
+        std::cout << "Ranks: " << size << " (" << dims[0] << " x " << dims[1] << " grid), threads per rank: "
+                  << omp_get_max_threads() << ", n = " << n << " (" << 8.0 * n * n / 1e9 << " GB)" << std::endl
+                  << std::endl;
+
+    run(n, 1, rank);
+    if (chunks > 1)
+        run(n, chunks, rank);
+
+    MPI_Finalize();
+    return 0;
+}
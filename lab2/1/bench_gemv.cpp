@@ -0,0 +1,100 @@
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <omp.h>
+#include "matrix.h"
+#include "gemv.h"
+#include "bench.h"
+
+
+// the loop test2.cpp used before: accumulates straight into result[i]
+void gemv_naive(const Matrix<double>& matrix, const double* x, double* y) {
+    const long n = matrix.rows();
+#pragma omp parallel for
+    for (long i = 0; i < n; i++) {
+        Span<const double> row = matrix.row(i);
+        y[i] = 0.0;
+        for (long j = 0; j < n; j++)
+            y[i] += row[j] * x[j];
+    }
+}
+
+// streaming read of every row with 4 independent vector sums: what GEMV can
+// hope for, since it has to read the whole matrix once
+__attribute__((target_clones("arch=x86-64-v4", "arch=x86-64-v3", "default")))
+static double sum_row(const double* row, long n) {
+    using gemv_detail::vec;
+    vec acc0 = {}, acc1 = {}, acc2 = {}, acc3 = {}, v;
+    long j = 0;
+    for (; j + 4 * GEMV_LANES <= n; j += 4 * GEMV_LANES) {
+        std::memcpy(&v, row + j, sizeof(v));
+        acc0 += v;
+        std::memcpy(&v, row + j + GEMV_LANES, sizeof(v));
+        acc1 += v;
+        std::memcpy(&v, row + j + 2 * GEMV_LANES, sizeof(v));
+        acc2 += v;
+        std::memcpy(&v, row + j + 3 * GEMV_LANES, sizeof(v));
+        acc3 += v;
+    }
+    acc0 += acc1 + acc2 + acc3;
+    double sum = gemv_detail::hsum(acc0);
+    for (; j < n; j++)
+        sum += row[j];
+    return sum;
+}
+
+// sum of every element, a row at a time
+double read_matrix(const Matrix<double>& matrix) {
+    const long n = matrix.rows();
+    double sum = 0.0;
+#pragma omp parallel for reduction(+:sum)
+    for (long i = 0; i < n; i++)
+        sum += sum_row(matrix.row(i).data(), n);
+    return sum;
+}
+
+
+// usage: bench_gemv [n...]
+int main(int argc, char** argv) {
+    std::vector<int> sizes;
+    for (int i = 1; i < argc; i++)
+        sizes.push_back(std::atoi(argv[i]));
+    if (sizes.empty())
+        sizes = {20000, 40000};
+
+    std::cout << "Threads: " << omp_get_max_threads() << std::endl << std::endl;
+
+    Sweep sweep("lab2/1 bench_gemv");
+    const int threads = omp_get_max_threads();
+    for (int n : sizes) {
+        Matrix<double> matrix(n, n);
+        std::vector<double> x(n, 2.0), y(n), y_naive(n);
+#pragma omp parallel for
+        for (int i = 0; i < n; i++)
+            for (int j = 0; j < n; j++)
+                matrix(i, j) = (i + j) % 7;
+
+        // the matrix is read once; x and y are small
+        const double bytes = 8.0 * n * n;
+        sweep.annotate(2.0 * n * n, bytes);
+        double naive = sweep.run("naive", n, threads, [&] { gemv_naive(matrix, x.data(), y_naive.data()); }).stats.median;
+        double blocked = sweep.run("blocked", n, threads, [&] { gemv_parallel(matrix, x.data(), y.data()); }).stats.median;
+        double sum = 0.0;
+        sweep.annotate(1.0 * n * n, bytes);
+        double limit = sweep.run("read", n, threads, [&] { sum += read_matrix(matrix); }).stats.median;
+        if (sum == -1.0)
+            std::cout << sum;
+
+        bool same = true;
+        for (int i = 0; i < n; i++)
+            same = same && y[i] == y_naive[i];
+
+        std::cout << "n = " << n << ": naive " << bytes / naive / 1e9 << " GB/s, blocked " << bytes / blocked / 1e9
+                  << " GB/s, read limit " << bytes / limit / 1e9 << " GB/s (" << 100 * limit / blocked << "%)"
+                  << (same ? "" : ", RESULTS DIFFER") << std::endl << std::endl;
+    }
+
+    sweep.save();
+    return 0;
+}
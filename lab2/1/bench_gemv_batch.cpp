@@ -0,0 +1,60 @@
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <omp.h>
+#include "matrix.h"
+#include "gemv.h"
+#include "bench.h"
+
+
+// usage: bench_gemv_batch [n] [max k]
+// Effective GFLOP/s (2*n*n*k flops) of k separate gemv_parallel calls versus
+// one gemv_batch_parallel pass for k = 1, 2, 4, ..., max k.
+int main(int argc, char** argv) {
+    int n = argc > 1 ? std::atoi(argv[1]) : 20000;
+    int max_k = argc > 2 ? std::atoi(argv[2]) : 32;
+
+    std::cout << "Threads: " << omp_get_max_threads() << ", n = " << n << std::endl << std::endl;
+
+    Matrix<double> matrix(n, n);
+#pragma omp parallel for
+    for (int i = 0; i < n; i++)
+        for (int j = 0; j < n; j++)
+            matrix(i, j) = (i + 3 * j) % 11 - 5;
+
+    Sweep sweep("lab2/1 bench_gemv_batch");
+    const int threads = omp_get_max_threads();
+    for (int k = 1; k <= max_k; k *= 2) {
+        Matrix<double> x(n, k), y(n, k);
+        std::vector<std::vector<double>> columns(k, std::vector<double>(n));
+        std::vector<std::vector<double>> results(k, std::vector<double>(n));
+        for (int j = 0; j < n; j++)
+            for (int c = 0; c < k; c++)
+                x(j, c) = columns[c][j] = (j + c) % 5 - 2;
+
+        const std::string suffix = " k=" + std::to_string(k);
+        // separate calls read the matrix k times, the batch once
+        double flops = 2.0 * n * n * k;
+        sweep.annotate(flops, 8.0 * n * n * k);
+        double single = sweep.run("separate" + suffix, n, threads, [&] {
+            for (int c = 0; c < k; c++)
+                gemv_parallel(matrix, columns[c].data(), results[c].data());
+        }).stats.median;
+        sweep.annotate(flops, 8.0 * n * n);
+        double batched = sweep.run("batched" + suffix, n, threads, [&] { gemv_batch_parallel(matrix, x, y); }).stats.median;
+
+        double max_diff = 0.0;
+        for (int i = 0; i < n; i++)
+            for (int c = 0; c < k; c++)
+                max_diff = std::max(max_diff, std::abs(y(i, c) - results[c][i]));
+
+        std::cout << "k = " << k << ": separate " << flops / single / 1e9 << " GFLOP/s, batched "
+                  << flops / batched / 1e9 << " GFLOP/s, speedup " << single / batched
+                  << (max_diff == 0.0 ? "" : ", RESULTS DIFFER") << std::endl << std::endl;
+    }
+
+    sweep.save();
+    return 0;
+}
@@ -0,0 +1,70 @@
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <cmath>
+#include <sys/resource.h>
+#include <omp.h>
+#include "matrix.h"
+#include "gemv.h"
+#include "implicit_matrix.h"
+#include "bench.h"
+
+
+double peak_rss_mb() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.0;
+}
+
+
+// usage: bench_implicit [n] [stored|implicit|both]
+// Peak RSS only grows, so the matrix-free run goes first; run each mode on
+// its own to compare peaks at sizes near the memory limit.
+int main(int argc, char** argv) {
+    int n = argc > 1 ? std::atoi(argv[1]) : 20000;
+    std::string mode = argc > 2 ? argv[2] : "both";
+
+    std::cout << "Threads: " << omp_get_max_threads() << ", n = " << n << ", dense matrix "
+              << static_cast<double>(n) * n * sizeof(double) / 1e9 << " GB" << std::endl << std::endl;
+
+    std::vector<double> x(n), y_implicit(n), y_stored(n);
+    for (int j = 0; j < n; j++)
+        x[j] = j % 13 - 6;
+
+    Sweep sweep("lab2/1 bench_implicit");
+    const int threads = omp_get_max_threads();
+    sweep.annotate(2.0 * n * n, 0.0);
+
+    if (mode != "stored") {
+        ImplicitMatrix<double, IndexSum> matrix(n, n);
+        double runtime = sweep.run("matrix-free", n, threads, [&] { gemv_parallel(matrix, x.data(), y_implicit.data()); }).stats.median;
+        std::cout << "matrix-free: " << runtime << " s, " << 2.0 * n * n / runtime / 1e9 << " GFLOP/s, peak RSS "
+                  << peak_rss_mb() << " MB" << std::endl;
+    }
+
+    if (mode != "implicit") {
+        Matrix<double> matrix(n, n);
+        // the first (warmup) fill also faults the pages in
+        sweep.annotate(0.0, 8.0 * n * n);
+        double init_time = sweep.run("fill", n, threads, [&] {
+#pragma omp parallel for
+            for (int i = 0; i < n; i++)
+                for (int j = 0; j < n; j++)
+                    matrix(i, j) = i + j;
+        }).stats.median;
+        sweep.annotate(2.0 * n * n, 8.0 * n * n);
+        double runtime = sweep.run("stored", n, threads, [&] { gemv_parallel(matrix, x.data(), y_stored.data()); }).stats.median;
+        std::cout << "stored:      " << runtime << " s, " << 2.0 * n * n / runtime / 1e9 << " GFLOP/s, peak RSS "
+                  << peak_rss_mb() << " MB, plus " << init_time << " s to fill" << std::endl;
+    }
+
+    if (mode == "both") {
+        double max_rel = 0.0;
+        for (int i = 0; i < n; i++)
+            max_rel = std::max(max_rel, std::abs(y_implicit[i] - y_stored[i]) / std::max(1.0, std::abs(y_stored[i])));
+        std::cout << "max relative difference: " << max_rel << std::endl;
+    }
+
+    sweep.save();
+    return 0;
+}
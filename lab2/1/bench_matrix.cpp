@@ -0,0 +1,73 @@
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <omp.h>
+#include "matrix.h"
+#include "bench.h"
+
+
+// the old storage: one heap block per row
+void gemv_nested(const std::vector<std::vector<double>>& matrix, const std::vector<double>& vector, std::vector<double>& result, int n) {
+#pragma omp parallel for
+    for (int i = 0; i < n; i++) {
+        double sum = 0.0;
+        for (int j = 0; j < n; j++)
+            sum += matrix[i][j] * vector[j];
+        result[i] = sum;
+    }
+}
+
+void gemv_matrix(const Matrix<double>& matrix, const std::vector<double>& vector, std::vector<double>& result, int n) {
+#pragma omp parallel for
+    for (int i = 0; i < n; i++) {
+        Span<const double> row = matrix.row(i);
+        double sum = 0.0;
+        for (int j = 0; j < n; j++)
+            sum += row[j] * vector[j];
+        result[i] = sum;
+    }
+}
+
+
+// usage: bench_matrix [n...]
+int main(int argc, char** argv) {
+    std::vector<int> sizes;
+    for (int i = 1; i < argc; i++)
+        sizes.push_back(std::atoi(argv[i]));
+    if (sizes.empty())
+        sizes = {4000, 10000};
+
+    std::cout << "Threads: " << omp_get_max_threads() << std::endl << std::endl;
+
+    Sweep sweep("lab2/1 bench_matrix");
+    const int threads = omp_get_max_threads();
+    for (int n : sizes) {
+        std::vector<double> vector(n, 2.0), result(n);
+        double bytes = static_cast<double>(n) * n * sizeof(double);
+
+        // allocation, fill and release of the whole matrix
+        sweep.annotate(0.0, 0.0);
+        double nested_alloc = sweep.run("nested alloc+fill", n, threads, [&] {
+            std::vector<std::vector<double>> nested(n, std::vector<double>(n, 1.0));
+        }).stats.median;
+        double matrix_alloc = sweep.run("matrix alloc+fill", n, threads, [&] { Matrix<double> matrix(n, n, 1.0); }).stats.median;
+
+        sweep.annotate(2.0 * n * n, bytes);
+        double nested_gemv;
+        {
+            std::vector<std::vector<double>> nested(n, std::vector<double>(n, 1.0));
+            nested_gemv = sweep.run("nested gemv", n, threads, [&] { gemv_nested(nested, vector, result, n); }).stats.median;
+        }
+        Matrix<double> matrix(n, n, 1.0);
+        double matrix_gemv = sweep.run("matrix gemv", n, threads, [&] { gemv_matrix(matrix, vector, result, n); }).stats.median;
+
+        std::cout << "n = " << n << std::endl;
+        std::cout << "vector<vector<double>>: alloc+fill " << nested_alloc << " sec, GEMV " << nested_gemv
+                  << " sec, " << bytes / nested_gemv / 1e9 << " GB/s" << std::endl;
+        std::cout << "Matrix<double>:         alloc+fill " << matrix_alloc << " sec, GEMV " << matrix_gemv
+                  << " sec, " << bytes / matrix_gemv / 1e9 << " GB/s" << std::endl << std::endl;
+    }
+
+    sweep.save();
+    return 0;
+}
@@ -0,0 +1,123 @@
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <string>
+#include <omp.h>
+#include "matrix.h"
+#include "memory_policy.h"
+#include "bench.h"
+
+
+enum class Init {
+    Serial,   // one thread writes everything, as Matrix(rows, cols, value) does
+    Static,   // omp parallel for, default static schedule
+};
+
+void fill(Matrix<double>& matrix, Init init) {
+    const long n = matrix.rows();
+    if (init == Init::Serial) {
+        for (long i = 0; i < n; i++)
+            for (long j = 0; j < n; j++)
+                matrix(i, j) = i + j;
+        return;
+    }
+#pragma omp parallel for schedule(static)
+    for (long i = 0; i < n; i++)
+        for (long j = 0; j < n; j++)
+            matrix(i, j) = i + j;
+}
+
+// y = A*x, recording the node of the thread that handled each row
+void gemv(const Matrix<double>& matrix, const std::vector<double>& x, std::vector<double>& y,
+          std::vector<int>& row_node, bool guided) {
+    const long n = matrix.rows();
+#pragma omp parallel
+    {
+        int node = current_node();
+        if (guided) {
+#pragma omp for schedule(guided)
+            for (long i = 0; i < n; i++) {
+                Span<const double> row = matrix.row(i);
+                double sum = 0.0;
+                for (long j = 0; j < n; j++)
+                    sum += row[j] * x[j];
+                y[i] = sum;
+                row_node[i] = node;
+            }
+        } else {
+#pragma omp for schedule(static)
+            for (long i = 0; i < n; i++) {
+                Span<const double> row = matrix.row(i);
+                double sum = 0.0;
+                for (long j = 0; j < n; j++)
+                    sum += row[j] * x[j];
+                y[i] = sum;
+                row_node[i] = node;
+            }
+        }
+    }
+}
+
+// fraction of matrix bytes that live on another node than the thread that
+// reads them
+double remote_fraction(const Matrix<double>& matrix, const std::vector<int>& row_node) {
+    const std::size_t page = sysconf(_SC_PAGESIZE);
+    std::vector<int> nodes = page_nodes(matrix.data(), matrix.bytes());
+    const std::size_t row_bytes = matrix.ld() * sizeof(double);
+    const std::uintptr_t base = reinterpret_cast<std::uintptr_t>(matrix.data()) / page * page;
+    double remote = 0.0;
+    for (std::size_t i = 0; i < matrix.rows(); i++) {
+        std::uintptr_t begin = reinterpret_cast<std::uintptr_t>(matrix.data()) + i * row_bytes;
+        for (std::uintptr_t p = begin / page * page; p < begin + row_bytes; p += page) {
+            int node = nodes[(p - base) / page];
+            std::uintptr_t overlap = std::min(p + page, begin + row_bytes) - std::max(p, begin);
+            if (node >= 0 && node != row_node[i])
+                remote += overlap;
+        }
+    }
+    return remote / (matrix.rows() * row_bytes);
+}
+
+void run(Sweep& sweep, const std::string& name, int n, const MemoryPolicy& policy, Init init, bool guided) {
+    long huge_before = huge_page_kb();
+    Matrix<double> matrix(n, n, policy);
+    fill(matrix, init);
+    long huge = huge_page_kb() - huge_before;
+
+    std::vector<double> x(n, 1.0), y(n);
+    std::vector<int> row_node(n);
+    sweep.annotate(2.0 * n * n, matrix.bytes());
+    double median = sweep.run(name.substr(0, name.find_last_not_of(' ') + 1), n, omp_get_max_threads(), [&] {
+        gemv(matrix, x, y, row_node, guided);
+    }).stats.median;
+
+    std::cout << name << ": " << median * 1e3 << " ms, " << matrix.bytes() / median / 1e9 << " GB/s, remote "
+              << 100 * remote_fraction(matrix, row_node) << "% of matrix bytes, huge pages " << huge / 1024
+              << " MB" << std::endl;
+}
+
+
+// usage: bench_numa [n]
+// Remote traffic is measured, not estimated: every row records the node of
+// the thread that read it and move_pages reports the node of every page.
+int main(int argc, char** argv) {
+    int n = argc > 1 ? std::atoi(argv[1]) : 20000;
+
+    std::cout << "Threads: " << omp_get_max_threads() << ", NUMA nodes: " << numa_nodes().size() << ", n = " << n
+              << " (" << static_cast<double>(n) * n * sizeof(double) / 1e9 << " GB)" << std::endl << std::endl;
+
+    Sweep sweep("lab2/1 bench_numa");
+
+    run(sweep, "serial init, static compute           ", n, MemoryPolicy(), Init::Serial, false);
+    run(sweep, "static init, guided compute (before)  ", n, MemoryPolicy(), Init::Static, true);
+    run(sweep, "static init, static compute (after)   ", n, MemoryPolicy::first_touch(), Init::Static, false);
+    run(sweep, "static init, static compute, THP      ", n, MemoryPolicy::first_touch(true), Init::Static, false);
+    run(sweep, "interleave                            ", n, MemoryPolicy::interleave(), Init::Static, false);
+    run(sweep, "interleave, THP                       ", n, MemoryPolicy::interleave(true), Init::Static, false);
+    for (int node : numa_nodes())
+        run(sweep, "node " + std::to_string(node) + "                                ", n, MemoryPolicy::on_node(node),
+            Init::Static, false);
+
+    sweep.save();
+    return 0;
+}
@@ -0,0 +1,69 @@
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <omp.h>
+#include "out_of_core.h"
+#include "ij_matrix.h"
+#include "bench.h"
+
+
+// the I/O wait of every timed multiply, for bench.h measure()
+struct IoWaitProbe {
+    const OutOfCoreGemv& a;
+    double total = 0.0;
+
+    void start() {}
+    void stop() { total += a.io_wait(); }
+    std::vector<std::pair<std::string, double>> metrics(int runs) const { return {{"io_wait", total / runs}}; }
+};
+
+void run(const std::string& path, OutOfCoreMode mode, long n, std::size_t panel_bytes) {
+    auto open_start = std::chrono::high_resolution_clock::now();
+    OutOfCoreGemv a(path, mode, panel_bytes);
+    auto open_end = std::chrono::high_resolution_clock::now();
+
+    std::vector<double> x(n, 1.0), y(n);
+    IoWaitProbe wait{a};
+    Stats stats = measure([&] { a.multiply(x.data(), y.data()); }, BenchOptions::from_env(), wait);
+
+    std::cout << mode_name(mode) << " -> " << mode_name(a.mode()) << ": open "
+              << std::chrono::duration<double>(open_end - open_start).count() << " s, multiply " << stats.median
+              << " s (median of " << stats.runs << "), " << a.bytes() / stats.median / 1e9 << " GB/s, I/O wait "
+              << wait.metrics(stats.runs)[0].second << " s, max rel error " << ij_max_error(y, n) << std::endl;
+}
+
+
+// usage: bench_out_of_core [n] [file] [panel MB] [auto|in-memory|mapped|streamed]
+// The file holds A = (i + j) and is written first if missing or not an n x n
+// matrix file. Finished panels are dropped from the page cache, so the streaming
+// modes read from the device on every multiply.
+int main(int argc, char** argv) {
+    long n = argc > 1 ? std::atol(argv[1]) : 16384;
+    std::string path = argc > 2 ? argv[2] : "matrix.bin";
+    std::size_t panel_bytes = argc > 3 ? std::atol(argv[3]) << 20 : OOC_PANEL_BYTES;
+    std::string only = argc > 4 ? argv[4] : "";
+
+    const std::size_t bytes = static_cast<std::size_t>(n) * n * sizeof(double);
+    if (!matrix_file_matches(path, n, n)) {
+        std::cout << "Writing " << path << " (" << bytes / 1e9 << " GB)" << std::endl;
+        write_matrix_file(path, n, n, [](long i, long j) { return ij_element(i, j); });
+    }
+
+    std::cout << "Threads: " << omp_get_max_threads() << ", n = " << n << " (" << bytes / 1e9 << " GB), available "
+              << available_memory() / 1e9 << " GB, panels " << panel_bytes / (1 << 20) << " MB" << std::endl
+              << std::endl;
+
+    for (OutOfCoreMode mode : {OutOfCoreMode::Auto, OutOfCoreMode::InMemory, OutOfCoreMode::Mapped, OutOfCoreMode::Streamed}) {
+        if (!only.empty() && only != mode_name(mode))
+            continue;
+        // in memory only when it fits, the other modes always
+        if (mode == OutOfCoreMode::InMemory && bytes >= MEMORY_FRACTION * available_memory())
+            continue;
+        run(path, mode, n, panel_bytes);
+    }
+
+    return 0;
+}
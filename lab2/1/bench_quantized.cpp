@@ -0,0 +1,71 @@
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <omp.h>
+#include "matrix.h"
+#include "gemv.h"
+#include "quantized.h"
+#include "bench.h"
+
+
+template <typename M>
+double run(Sweep& sweep, const std::string& name, const M& matrix, double element_bytes, const std::vector<double>& x,
+           const std::vector<double>& reference, double baseline) {
+    const double n = x.size();
+    std::vector<double> y(matrix.rows());
+    sweep.annotate(2.0 * n * n, n * n * element_bytes);
+    double runtime = sweep.run(name.substr(2, name.find(':') - 2), x.size(), omp_get_max_threads(), [&] {
+        gemv_parallel(matrix, x.data(), y.data());
+    }).stats.median;
+    RelativeError error = relative_error(y, reference);
+    std::cout << name << runtime * 1e3 << " ms, " << n * n * element_bytes / runtime / 1e9 << " GB/s, speedup "
+              << (baseline > 0 ? baseline / runtime : 1.0) << ", relative error " << error.norm << " (2-norm), "
+              << error.max << " (max)" << std::endl;
+    return runtime;
+}
+
+
+// usage: bench_quantized [n...]
+int main(int argc, char** argv) {
+    std::vector<int> sizes;
+    for (int i = 1; i < argc; i++)
+        sizes.push_back(std::atoi(argv[i]));
+    if (sizes.empty())
+        sizes = {20000, 40000};
+
+    std::cout << "Threads: " << omp_get_max_threads() << std::endl << std::endl;
+
+    Sweep sweep("lab2/1 bench_quantized");
+    for (int n : sizes) {
+        Matrix<double> matrix(n, n);
+#pragma omp parallel for
+        for (int i = 0; i < n; i++)
+            for (int j = 0; j < n; j++)
+                matrix(i, j) = std::sin(0.001 * i * j) + 0.5 * std::cos(0.37 * (i + 2 * j));
+        std::vector<double> x(n), reference(n);
+        for (int j = 0; j < n; j++)
+            x[j] = std::cos(0.01 * j);
+
+        std::cout << "n = " << n << ":" << std::endl;
+        gemv_parallel(matrix, x.data(), reference.data());
+        double baseline = run(sweep, "  fp64: ", matrix, sizeof(double), x, reference, 0.0);
+        {
+            Matrix<float> fp32 = convert_matrix<float>(matrix);
+            run(sweep, "  fp32: ", fp32, sizeof(float), x, reference, baseline);
+        }
+        {
+            Matrix<bfloat16> bf16 = convert_matrix<bfloat16>(matrix);
+            run(sweep, "  bf16: ", bf16, sizeof(bfloat16), x, reference, baseline);
+        }
+        {
+            Int8Matrix int8 = quantize_int8(matrix);
+            run(sweep, "  int8: ", int8, sizeof(int8_t), x, reference, baseline);
+        }
+        std::cout << std::endl;
+    }
+
+    sweep.save();
+    return 0;
+}
@@ -0,0 +1,159 @@
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <cmath>
+#include <random>
+#include <string>
+#include <omp.h>
+#include "matrix.h"
+#include "sparse.h"
+#include "gemv.h"
+#include "bench.h"
+
+const int PARTS = 8;
+
+
+// Rows with 2 * half + 1 entries around the diagonal.
+CsrMatrix<double> banded_matrix(int n, int half) {
+    CsrMatrix<double> a;
+    a.rows = a.cols = n;
+    a.row_ptr.assign(1, 0);
+    for (int i = 0; i < n; i++) {
+        for (int j = std::max(0, i - half); j <= std::min(n - 1, i + half); j++) {
+            a.col.push_back(j);
+            a.val.push_back(j == i ? 2.0 * half : -1.0);
+        }
+        a.row_ptr.push_back(static_cast<long>(a.val.size()));
+    }
+    return a;
+}
+
+// Row lengths drawn from a Pareto distribution with the given exponent and
+// mean, columns uniform: a few very long rows, most of them short, as in
+// web or social graphs.
+CsrMatrix<double> power_law_matrix(int n, double mean, double exponent, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::uniform_int_distribution<int> column(0, n - 1);
+    const double scale = mean * (exponent - 1) / exponent;
+
+    CsrMatrix<double> a;
+    a.rows = a.cols = n;
+    a.row_ptr.assign(1, 0);
+    std::vector<int> cols;
+    for (int i = 0; i < n; i++) {
+        double length = scale / std::pow(1.0 - uniform(rng), 1.0 / exponent);
+        int count = std::min(n, std::max(1, static_cast<int>(length)));
+        cols.clear();
+        for (int k = 0; k < count; k++)
+            cols.push_back(column(rng));
+        std::sort(cols.begin(), cols.end());
+        cols.erase(std::unique(cols.begin(), cols.end()), cols.end());
+        for (int j : cols) {
+            a.col.push_back(j);
+            a.val.push_back(uniform(rng) - 0.5);
+        }
+        a.row_ptr.push_back(static_cast<long>(a.val.size()));
+    }
+    return a;
+}
+
+
+// largest part's entries over the mean, for equal row counts and for the
+// nnz-balanced split
+void report_balance(const CsrMatrix<double>& a) {
+    long rows = a.rows, total = a.row_ptr[rows];
+    long equal = 0, balanced = 0;
+    for (int p = 0; p < PARTS; p++) {
+        long r0 = rows * p / PARTS, r1 = rows * (p + 1) / PARTS;
+        equal = std::max(equal, a.row_ptr[r1] - a.row_ptr[r0]);
+        long b0 = balanced_split(a.row_ptr, p, PARTS), b1 = balanced_split(a.row_ptr, p + 1, PARTS);
+        balanced = std::max(balanced, a.row_ptr[b1] - a.row_ptr[b0]);
+    }
+    double mean = static_cast<double>(total) / PARTS;
+    std::cout << "  largest of " << PARTS << " parts / mean: equal rows " << equal / mean << ", nnz-balanced "
+              << balanced / mean << std::endl;
+}
+
+// records are named "<matrix> <format> omp|threads"
+template <typename M>
+void run_format(Sweep& sweep, const std::string& matrix, const std::string& name, const M& a, std::size_t stored,
+                std::size_t bytes, long nnz, const std::vector<double>& x, const std::vector<double>& reference) {
+    std::vector<double> y(a.rows);
+    int threads = omp_get_max_threads();
+    const std::string kernel = matrix + " " + name.substr(0, name.find_last_not_of(' ') + 1);
+    sweep.annotate(2.0 * nnz, bytes);
+    double t_omp = sweep.run(kernel + " omp", a.rows, threads, [&] { spmv_omp(a, x.data(), y.data()); }).stats.median;
+    bool same = y == reference;
+    double t_threads = sweep.run(kernel + " threads", a.rows, threads, [&] {
+        spmv_threads(a, x.data(), y.data(), threads);
+    }).stats.median;
+    same = same && y == reference;
+    std::cout << "  " << name << ": " << stored << " stored (" << bytes / 1e6 << " MB), OpenMP "
+              << 2.0 * nnz / t_omp / 1e9 << " GFLOP/s, std::thread " << 2.0 * nnz / t_threads / 1e9 << " GFLOP/s"
+              << (same ? "" : ", RESULTS DIFFER") << std::endl;
+}
+
+void run_matrix(Sweep& sweep, const std::string& matrix, const std::string& title, const CsrMatrix<double>& csr) {
+    long nnz = csr.nnz();
+    std::cout << title << ": n = " << csr.rows << ", nnz = " << nnz << std::endl;
+    report_balance(csr);
+
+    std::vector<double> x(csr.cols), reference(csr.rows);
+    for (std::size_t j = 0; j < csr.cols; j++)
+        x[j] = 1.0 + j % 3;
+    csr.multiply(x.data(), reference.data(), 0, csr.rows);
+
+    const std::size_t entry = sizeof(double) + sizeof(int);
+    run_format(sweep, matrix, "CSR       ", csr, csr.nnz(), csr.nnz() * entry + csr.row_ptr.size() * sizeof(long), nnz, x, reference);
+
+    // ELLPACK pads every row to the longest one, hopeless for power-law rows
+    long width = 0;
+    for (std::size_t i = 0; i < csr.rows; i++)
+        width = std::max(width, csr.row_ptr[i + 1] - csr.row_ptr[i]);
+    if (width * csr.rows <= 8 * csr.nnz())
+        run_format(sweep, matrix, "ELLPACK   ", to_ell(csr), width * csr.rows, width * csr.rows * entry, nnz, x, reference);
+    else
+        std::cout << "  ELLPACK   : skipped, width " << width << " would store " << width * csr.rows << std::endl;
+
+    // a wider sorting window trades locality of y for less padding
+    for (std::size_t sigma : {std::size_t(256), csr.rows}) {
+        auto sell = to_sell(csr, sigma);
+        std::string name = "SELL-8-" + (sigma == csr.rows ? std::string("n  ") : std::to_string(sigma));
+        run_format(sweep, matrix, name, sell, sell.stored(), sell.stored() * entry + sell.perm.size() * sizeof(int), nnz, x,
+                   reference);
+    }
+    std::cout << std::endl;
+}
+
+
+// usage: bench_spmv [n]
+int main(int argc, char** argv) {
+    int n = argc > 1 ? std::atoi(argv[1]) : 1000000;
+
+    std::cout << "Threads: " << omp_get_max_threads() << std::endl << std::endl;
+
+    // conversion from dense storage against the dense kernel
+    {
+        const int m = 1000;
+        Matrix<double> dense(m, m, 0.0);
+        for (int i = 0; i < m; i++)
+            for (int j = std::max(0, i - 3); j <= std::min(m - 1, i + 3); j++)
+                dense(i, j) = 1.0 + (i + j) % 4;
+        std::vector<double> x(m, 1.5), y_dense(m), y_sparse(m);
+        gemv_parallel(dense, x.data(), y_dense.data());
+        spmv_omp(to_sell(to_csr(dense)), x.data(), y_sparse.data());
+        double max_diff = 0.0;
+        for (int i = 0; i < m; i++)
+            max_diff = std::max(max_diff, std::abs(y_dense[i] - y_sparse[i]));
+        std::cout << "Dense -> CSR -> SELL, n = " << m << ": max difference to dense GEMV " << max_diff << std::endl
+                  << std::endl;
+    }
+
+    Sweep sweep("lab2/1 bench_spmv");
+    run_matrix(sweep, "banded", "Banded (bandwidth 27)", banded_matrix(n, 13));
+    run_matrix(sweep, "power-law", "Power law (mean 16, exponent 1.5)", power_law_matrix(n, 16.0, 1.5, 1));
+
+    sweep.save();
+    return 0;
+}
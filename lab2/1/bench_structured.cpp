@@ -0,0 +1,85 @@
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <omp.h>
+#include "matrix.h"
+#include "gemv.h"
+#include "implicit_matrix.h"
+#include "structured.h"
+#include "bench.h"
+
+
+double max_relative_difference(const std::vector<double>& a, const std::vector<double>& b) {
+    double diff = 0.0, scale = 0.0;
+    for (std::size_t i = 0; i < a.size(); i++) {
+        diff = std::max(diff, std::abs(a[i] - b[i]));
+        scale = std::max(scale, std::abs(b[i]));
+    }
+    return diff / std::max(scale, 1e-300);
+}
+
+// detection time, then the plain kernel of M against the dispatched one
+template <typename M>
+void run(Sweep& sweep, const std::string& title, const M& matrix) {
+    const int n = matrix.cols();
+    const int threads = omp_get_max_threads();
+    std::vector<double> x(n), y_plain(matrix.rows()), y_fast(matrix.rows());
+    for (int j = 0; j < n; j++)
+        x[j] = std::sin(0.01 * j);
+
+    sweep.annotate(0.0, 0.0);
+    double detect = sweep.run(title + " detection", n, threads, [&] { StructuredMatrix<M> timed(matrix); }).stats.median;
+    StructuredMatrix<M> structured(matrix);
+
+    double plain = sweep.run(title + " plain", n, threads, [&] {
+        gemv_parallel(matrix, x.data(), y_plain.data());
+    }).stats.median;
+    double fast = sweep.run(title + " dispatched", n, threads, [&] {
+        gemv_parallel(structured, x.data(), y_fast.data());
+    }).stats.median;
+
+    std::cout << title << ": " << structure_name(structured.structure());
+    if (structured.structure() == Structure::LowRank)
+        std::cout << " (rank " << structured.low_rank().rank() << ")";
+    std::cout << ", detection " << detect << " s, plain " << plain << " s, dispatched " << fast << " s, speedup "
+              << plain / fast << ", max relative difference " << max_relative_difference(y_fast, y_plain)
+              << std::endl;
+}
+
+template <typename F>
+Matrix<double> generate(int n, F f) {
+    Matrix<double> matrix(n, n);
+#pragma omp parallel for
+    for (int i = 0; i < n; i++)
+        for (int j = 0; j < n; j++)
+            matrix(i, j) = f(i, j);
+    return matrix;
+}
+
+double noise(long k) {
+    return ((k * 7919) % 1009) / 1009.0 - 0.5;
+}
+
+
+// usage: bench_structured [n] [n matrix-free]
+int main(int argc, char** argv) {
+    int n = argc > 1 ? std::atoi(argv[1]) : 8000;
+    int n_free = argc > 2 ? std::atoi(argv[2]) : 40000;
+
+    std::cout << "Threads: " << omp_get_max_threads() << ", n = " << n << std::endl << std::endl;
+
+    Sweep sweep("lab2/1 bench_structured");
+
+    run(sweep, "i + j as in main.cpp", generate(n, [](long i, long j) { return double(i + j); }));
+    run(sweep, "Toeplitz", generate(n, [](long i, long j) { return std::exp(-std::abs(i - j) / 50.0) + noise(i - j + 5000); }));
+    run(sweep, "Hankel", generate(n, [](long i, long j) { return noise(i + j); }));
+    run(sweep, "unstructured", generate(n, [](long i, long j) { return noise(i * 31 + j); }));
+
+    std::cout << std::endl << "Matrix-free, n = " << n_free << ":" << std::endl;
+    run(sweep, "i + j as in main.cpp", ImplicitMatrix<double, IndexSum>(n_free, n_free));
+
+    sweep.save();
+    return 0;
+}
@@ -0,0 +1,79 @@
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <omp.h>
+#include "matrix.h"
+#include "gemv.h"
+#include "symmetric.h"
+#include "ij_matrix.h"
+#include "bench.h"
+
+
+double max_relative_difference(const std::vector<double>& a, const std::vector<double>& b) {
+    double diff = 0.0, scale = 0.0;
+    for (std::size_t i = 0; i < a.size(); i++) {
+        diff = std::max(diff, std::abs(a[i] - b[i]));
+        scale = std::max(scale, std::abs(b[i]));
+    }
+    return diff / std::max(scale, 1e-300);
+}
+
+void report(const std::string& title, double seconds, double bytes, double difference) {
+    std::cout << "  " << title << ": " << seconds << " s, " << bytes / seconds / 1e9 << " GB/s of stored matrix, "
+              << "max relative difference " << difference << std::endl;
+}
+
+template <typename F>
+Matrix<double> generate(long rows, long cols, F f) {
+    Matrix<double> matrix(rows, cols);
+#pragma omp parallel for
+    for (long i = 0; i < rows; i++)
+        for (long j = 0; j < cols; j++)
+            matrix(i, j) = f(i, j);
+    return matrix;
+}
+
+
+// usage: bench_symmetric [n]
+// The symmetric matrix is i + j as in main.cpp; both kernels are compared
+// with gemv_parallel on the dense matrix (A^T*x on its explicit transpose).
+int main(int argc, char** argv) {
+    long n = argc > 1 ? std::atol(argv[1]) : 12000;
+
+    std::cout << "Threads: " << omp_get_max_threads() << ", n = " << n << std::endl << std::endl;
+
+    std::vector<double> x(n), y_dense(n), y(n);
+    for (long j = 0; j < n; j++)
+        x[j] = std::sin(0.01 * j);
+    const double dense_bytes = 8.0 * n * n;
+
+    {
+        Matrix<double> dense = generate(n, n, ij_element);
+        SymmetricMatrix packed(dense);
+        std::cout << "Symmetric, packed " << packed.bytes() / 1e9 << " GB of " << dense_bytes / 1e9 << " GB:" << std::endl;
+        double plain = measure([&] { gemv_parallel(dense, x.data(), y_dense.data()); }).median;
+        report("dense gemv", plain, dense_bytes, 0.0);
+        double symv = measure([&] { gemv_parallel(packed, x.data(), y.data()); }).median;
+        report("packed symv", symv, packed.bytes(), max_relative_difference(y, y_dense));
+        std::cout << "  speedup " << plain / symv << std::endl << std::endl;
+    }
+
+    {
+        // rectangular, so the two shapes are told apart
+        const long m = n + n / 3;
+        Matrix<double> a = generate(m, n, [](long i, long j) { return std::cos(0.001 * i * j) + 0.5 * (i % 7); });
+        Matrix<double> t = generate(n, m, [&](long i, long j) { return a(j, i); });
+        std::vector<double> xt(m), yt_dense(n), yt(n);
+        for (long i = 0; i < m; i++)
+            xt[i] = std::sin(0.01 * i);
+        std::cout << "Transposed, " << m << " x " << n << ":" << std::endl;
+        double plain = measure([&] { gemv_parallel(t, xt.data(), yt_dense.data()); }).median;
+        report("gemv on the transpose", plain, 8.0 * m * n, 0.0);
+        double trans = measure([&] { gemv_transposed_parallel(a, xt.data(), yt.data()); }).median;
+        report("gemv_transposed", trans, 8.0 * m * n, max_relative_difference(yt, yt_dense));
+    }
+
+    return 0;
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <vector>
+#include <mpi.h>
+#include <omp.h>
+#include "matrix.h"
+#include "gemv.h"
+
+// y = A*x with A split over a 2-D grid of MPI ranks and OpenMP threads
+// inside each rank.
+//
+// The ranks form a Pr x Pc grid (MPI_Dims_create); rank (r, c) owns the
+// block of rows r and columns c of A. x block c starts on grid row 0 and is
+// broadcast down column c; every rank multiplies its block, and the partial
+// results are summed along grid row r into y block r on grid column 0:
+//
+//   DistributedGemv a(n, n);                  // collective
+//   fill a.block() for rows [row_begin, row_end), cols [col_begin, col_end)
+//   a.multiply(x_block, y_block);             // collective
+//
+// Overlap: x arrives in `chunks` nonblocking broadcasts (MPI_Ibcast on the
+// column communicator) and each chunk's columns are multiplied as soon as
+// it is in, while the later ones are still in flight. The last chunk is
+// multiplied in `chunks` row panels, each panel's sum (MPI_Ireduce on the
+// row communicator) starting while the next panel is computed. chunks = 1
+// is the plain broadcast, multiply, reduce.
+//
+// MPI is called from the master thread only, outside parallel regions, so
+// MPI_THREAD_FUNNELED is enough.
+
+const int DIST_CHUNKS = 8;
+
+// first index of part k of n split into `parts` nearly equal parts
+inline long block_begin(long n, int parts, int k) {
+    return n * k / parts;
+}
+
+
+class DistributedGemv {
+public:
+    DistributedGemv(long rows, long cols, MPI_Comm comm = MPI_COMM_WORLD, int chunks = DIST_CHUNKS)
+        : rows_(rows), cols_(cols), chunks_(std::max(1, chunks)) {
+        int size;
+        MPI_Comm_size(comm, &size);
+        int dims[2] = {0, 0}, periods[2] = {0, 0}, coords[2];
+        MPI_Dims_create(size, 2, dims);
+        if (rows_ < dims[0] || cols_ < dims[1])
+            throw std::invalid_argument("DistributedGemv: matrix smaller than the process grid");
+        MPI_Cart_create(comm, 2, dims, periods, 0, &grid_);
+        int rank;
+        MPI_Comm_rank(grid_, &rank);
+        MPI_Cart_coords(grid_, rank, 2, coords);
+        grid_rows_ = dims[0];
+        grid_cols_ = dims[1];
+        grid_row_ = coords[0];
+        grid_col_ = coords[1];
+
+        // ranks of the sub-communicators follow the grid coordinate, so the
+        // root 0 of a column is grid row 0 and that of a row is grid column 0
+        int keep_cols[2] = {0, 1}, keep_rows[2] = {1, 0};
+        MPI_Cart_sub(grid_, keep_cols, &row_);
+        MPI_Cart_sub(grid_, keep_rows, &col_);
+
+        block_ = Matrix<double>(row_end() - row_begin(), col_end() - col_begin());
+        x_.resize(block_.cols());
+        partial_.resize(block_.rows());
+    }
+
+    ~DistributedGemv() {
+        MPI_Comm_free(&row_);
+        MPI_Comm_free(&col_);
+        MPI_Comm_free(&grid_);
+    }
+
+    DistributedGemv(const DistributedGemv&) = delete;
+    DistributedGemv& operator=(const DistributedGemv&) = delete;
+
+    int grid_rows() const { return grid_rows_; }
+    int grid_cols() const { return grid_cols_; }
+    int grid_row() const { return grid_row_; }
+    int grid_col() const { return grid_col_; }
+
+    long row_begin() const { return block_begin(rows_, grid_rows_, grid_row_); }
+    long row_end() const { return block_begin(rows_, grid_rows_, grid_row_ + 1); }
+    long col_begin() const { return block_begin(cols_, grid_cols_, grid_col_); }
+    long col_end() const { return block_begin(cols_, grid_cols_, grid_col_ + 1); }
+
+    // x block [col_begin, col_end) is read on grid row 0, y block
+    // [row_begin, row_end) is written on grid column 0
+    bool holds_x() const { return grid_row_ == 0; }
+    bool holds_y() const { return grid_col_ == 0; }
+
+    Matrix<double>& block() { return block_; }
+    MPI_Comm grid() const { return grid_; }
+
+    // Seconds the last multiply spent blocked in MPI waits after its own
+    // work was done; near 0 when communication fully overlaps compute.
+    double comm_wait() const { return comm_wait_; }
+
+    // y = A*x, collective over the grid. x is ignored off grid row 0 and y is
+    // left alone off grid column 0 (either may be null there).
+    void multiply(const double* x, double* y) {
+        comm_wait_ = 0.0;
+        const long local_rows = block_.rows(), local_cols = block_.cols();
+        if (holds_x())
+            std::copy(x, x + local_cols, x_.begin());
+
+        std::vector<MPI_Request> bcasts(chunks_), reduces(chunks_);
+        for (int k = 0; k < chunks_; k++) {
+            long j0 = block_begin(local_cols, chunks_, k), j1 = block_begin(local_cols, chunks_, k + 1);
+            MPI_Ibcast(x_.data() + j0, static_cast<int>(j1 - j0), MPI_DOUBLE, 0, col_, &bcasts[k]);
+        }
+
+        std::fill(partial_.begin(), partial_.end(), 0.0);
+        for (int k = 0; k < chunks_; k++) {
+            long j0 = block_begin(local_cols, chunks_, k), j1 = block_begin(local_cols, chunks_, k + 1);
+            wait(bcasts[k]);
+            if (k + 1 < chunks_) {
+                accumulate(0, local_rows, j0, j1);
+                continue;
+            }
+            // last chunk: finish the rows panel by panel and start their sums
+            for (int p = 0; p < chunks_; p++) {
+                long i0 = block_begin(local_rows, chunks_, p), i1 = block_begin(local_rows, chunks_, p + 1);
+                accumulate(i0, i1, j0, j1);
+                MPI_Ireduce(holds_y() ? MPI_IN_PLACE : partial_.data() + i0, holds_y() ? partial_.data() + i0 : nullptr,
+                            static_cast<int>(i1 - i0), MPI_DOUBLE, MPI_SUM, 0, row_, &reduces[p]);
+                // give the library a chance to progress the posted sums
+                int done;
+                MPI_Testall(p + 1, reduces.data(), &done, MPI_STATUSES_IGNORE);
+            }
+        }
+        for (MPI_Request& request : reduces)
+            wait(request);
+
+        if (holds_y())
+            std::copy(partial_.begin(), partial_.end(), y);
+    }
+
+    // The whole y on grid rank 0 from the blocks on grid column 0; collective
+    // over the grid, `full` is only written on rank 0.
+    void gather(const double* y, std::vector<double>& full) const {
+        if (!holds_y())
+            return;
+        std::vector<int> counts(grid_rows_), displs(grid_rows_);
+        for (int r = 0; r < grid_rows_; r++) {
+            displs[r] = static_cast<int>(block_begin(rows_, grid_rows_, r));
+            counts[r] = static_cast<int>(block_begin(rows_, grid_rows_, r + 1)) - displs[r];
+        }
+        if (grid_row_ == 0)
+            full.resize(rows_);
+        MPI_Gatherv(y, counts[grid_row_], MPI_DOUBLE, full.data(), counts.data(), displs.data(), MPI_DOUBLE, 0, col_);
+    }
+
+private:
+    void wait(MPI_Request& request) {
+        auto start_time = std::chrono::high_resolution_clock::now();
+        MPI_Wait(&request, MPI_STATUS_IGNORE);
+        auto end_time = std::chrono::high_resolution_clock::now();
+        comm_wait_ += std::chrono::duration<double>(end_time - start_time).count();
+    }
+
+    // partial[i0:i1] += block[i0:i1, j0:j1] . x[j0:j1], rows split over the team
+    void accumulate(long i0, long i1, long j0, long j1) {
+        const double* a = block_.data();
+        const long ld = block_.ld();
+#pragma omp parallel
+        {
+            long t0, t1;
+            gemv_detail::thread_rows(i1 - i0, t0, t1);
+            for (long c0 = j0; c0 < j1 && t0 < t1; c0 += GEMV_TILE)
+                gemv_detail::gemv_tile(a, ld, x_.data(), partial_.data(), i0 + t0, i0 + t1, c0, std::min(j1, c0 + GEMV_TILE));
+        }
+    }
+
+    long rows_, cols_;
+    int chunks_;
+    MPI_Comm grid_, row_, col_;
+    int grid_rows_, grid_cols_, grid_row_, grid_col_;
+    Matrix<double> block_;
+    std::vector<double> x_, partial_;
+    double comm_wait_ = 0.0;
+};
@@ -0,0 +1,387 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <omp.h>
+#include "bfloat16.h"
+#include "matrix.h"
+
+// Blocked y = A*x for row-major Matrix<double>.
+//
+// Register blocking: 4 rows are processed together, each with its own
+// 8-lane vector accumulator, so every x load feeds 4 FMAs and there is no
+// loop-carried dependency through memory (the old kernels did
+// result[i] += ... on every iteration).
+//
+// Cache blocking: x is walked in tiles of GEMV_TILE elements that stay in
+// L2 while all rows pass over them; each tile adds its partial dot products
+// to y.
+//
+// The batched variant computes Y = A*X for k right-hand sides stored as the
+// columns of an n x k Matrix, so one pass over A serves all of them: every
+// A element is broadcast against a row of X, which is reused from cache
+// across the rows of the tile.
+//
+// The transposed variant computes y = A^T*x on the same row-major storage
+// without forming the transpose: every row adds x[i] * A[i, :] to y. Each
+// thread owns a contiguous range of columns, so its part of y is private and
+// needs no reduction; four rows are folded into every load and store of a y
+// tile, which stays in L1 while the rows stream past.
+//
+// The dot-product kernel also reads Matrix<float>, Matrix<bfloat16> and
+// Matrix<int8_t> (see quantized.h), widening each element to double on
+// load, so x, y and all accumulation stay in double.
+//
+// The row kernels are cloned for AVX-512, AVX2+FMA and baseline x86-64 and the
+// loader picks the best one for the CPU it runs on.
+
+const int GEMV_LANES = 8;
+const int GEMV_ROWS = 4;
+const long GEMV_TILE = 32768;  // 256 KiB of x
+const int GEMV_BATCH = 32;     // right-hand sides per register panel
+const long GEMV_TRANSPOSED_TILE = 4096;  // 32 KiB of y
+
+namespace gemv_detail {
+
+typedef double vec __attribute__((vector_size(GEMV_LANES * sizeof(double))));
+
+inline double hsum(const vec& v) {
+    double s = 0.0;
+    for (int l = 0; l < GEMV_LANES; l++)
+        s += v[l];
+    return s;
+}
+
+// GEMV_LANES elements of A widened to double; by reference, since returning
+// wide vectors by value would depend on -mavx
+__attribute__((always_inline)) inline void load(vec& out, const double* p) {
+    std::memcpy(&out, p, sizeof(out));
+}
+
+__attribute__((always_inline)) inline void load(vec& out, const float* p) {
+    typedef float raw __attribute__((vector_size(GEMV_LANES * sizeof(float))));
+    raw v;
+    std::memcpy(&v, p, sizeof(v));
+    out = __builtin_convertvector(v, vec);
+}
+
+// bfloat16 is the upper half of a float
+__attribute__((always_inline)) inline void load(vec& out, const bfloat16* p) {
+    typedef uint16_t raw __attribute__((vector_size(GEMV_LANES * sizeof(uint16_t))));
+    typedef uint32_t wide __attribute__((vector_size(GEMV_LANES * sizeof(uint32_t))));
+    typedef float real __attribute__((vector_size(GEMV_LANES * sizeof(float))));
+    raw v;
+    std::memcpy(&v, p, sizeof(v));
+    wide w = __builtin_convertvector(v, wide) << 16;
+    real f;
+    std::memcpy(&f, &w, sizeof(f));
+    out = __builtin_convertvector(f, vec);
+}
+
+// GCC extends an 8-byte int8 vector lane by lane in general registers, so
+// the bytes are sign-extended in place instead: each of the two 32-bit words
+// is broadcast to four lanes, shifted so the wanted byte is on top and
+// shifted back arithmetically (x86 is little endian)
+__attribute__((always_inline)) inline void load(vec& out, const int8_t* p) {
+    typedef int32_t wide __attribute__((vector_size(GEMV_LANES * sizeof(int32_t))));
+    int32_t words[2];
+    std::memcpy(words, p, sizeof(words));
+    wide w = {words[0], words[0], words[0], words[0], words[1], words[1], words[1], words[1]};
+    const wide shift = {24, 16, 8, 0, 24, 16, 8, 0};
+    w = (w << shift) >> 24;
+    out = __builtin_convertvector(w, vec);
+}
+
+// y[i] += A[i, j0:j1] . x[j0:j1] for i in [i0, i1)
+template <typename T>
+__attribute__((target_clones("arch=x86-64-v4", "arch=x86-64-v3", "default")))
+static void gemv_tile(const T* a, long ld, const double* x, double* y, long i0, long i1, long j0, long j1) {
+    long i = i0;
+    for (; i + GEMV_ROWS <= i1; i += GEMV_ROWS) {
+        const T* r0 = a + i * ld;
+        const T* r1 = r0 + ld;
+        const T* r2 = r1 + ld;
+        const T* r3 = r2 + ld;
+        vec acc0 = {}, acc1 = {}, acc2 = {}, acc3 = {};
+        vec xv, av;
+        long j = j0;
+        for (; j + GEMV_LANES <= j1; j += GEMV_LANES) {
+            std::memcpy(&xv, x + j, sizeof(xv));
+            load(av, r0 + j);
+            acc0 += av * xv;
+            load(av, r1 + j);
+            acc1 += av * xv;
+            load(av, r2 + j);
+            acc2 += av * xv;
+            load(av, r3 + j);
+            acc3 += av * xv;
+        }
+        double s0 = hsum(acc0), s1 = hsum(acc1), s2 = hsum(acc2), s3 = hsum(acc3);
+        for (; j < j1; j++) {
+            s0 += static_cast<double>(r0[j]) * x[j];
+            s1 += static_cast<double>(r1[j]) * x[j];
+            s2 += static_cast<double>(r2[j]) * x[j];
+            s3 += static_cast<double>(r3[j]) * x[j];
+        }
+        y[i] += s0;
+        y[i + 1] += s1;
+        y[i + 2] += s2;
+        y[i + 3] += s3;
+    }
+    for (; i < i1; i++) {
+        const T* row = a + i * ld;
+        vec acc = {}, xv, av;
+        long j = j0;
+        for (; j + GEMV_LANES <= j1; j += GEMV_LANES) {
+            std::memcpy(&xv, x + j, sizeof(xv));
+            load(av, row + j);
+            acc += av * xv;
+        }
+        double s = hsum(acc);
+        for (; j < j1; j++)
+            s += static_cast<double>(row[j]) * x[j];
+        y[i] += s;
+    }
+}
+
+// y[j0:j1] += sum over i < rows of A[i, j0:j1] * x[i]
+template <typename T>
+__attribute__((target_clones("arch=x86-64-v4", "arch=x86-64-v3", "default")))
+static void gemv_transposed_tile(const T* a, long ld, long rows, const double* x, double* y, long j0, long j1) {
+    long i = 0;
+    for (; i + GEMV_ROWS <= rows; i += GEMV_ROWS) {
+        const T* r0 = a + i * ld;
+        const T* r1 = r0 + ld;
+        const T* r2 = r1 + ld;
+        const T* r3 = r2 + ld;
+        vec x0 = {}, x1 = {}, x2 = {}, x3 = {};
+        x0 += x[i];
+        x1 += x[i + 1];
+        x2 += x[i + 2];
+        x3 += x[i + 3];
+        vec yv, av;
+        long j = j0;
+        for (; j + GEMV_LANES <= j1; j += GEMV_LANES) {
+            std::memcpy(&yv, y + j, sizeof(yv));
+            load(av, r0 + j);
+            yv += av * x0;
+            load(av, r1 + j);
+            yv += av * x1;
+            load(av, r2 + j);
+            yv += av * x2;
+            load(av, r3 + j);
+            yv += av * x3;
+            std::memcpy(y + j, &yv, sizeof(yv));
+        }
+        for (; j < j1; j++)
+            y[j] += static_cast<double>(r0[j]) * x[i] + static_cast<double>(r1[j]) * x[i + 1] +
+                    static_cast<double>(r2[j]) * x[i + 2] + static_cast<double>(r3[j]) * x[i + 3];
+    }
+    for (; i < rows; i++) {
+        const T* row = a + i * ld;
+        vec xv = {}, yv, av;
+        xv += x[i];
+        long j = j0;
+        for (; j + GEMV_LANES <= j1; j += GEMV_LANES) {
+            std::memcpy(&yv, y + j, sizeof(yv));
+            load(av, row + j);
+            yv += av * xv;
+            std::memcpy(y + j, &yv, sizeof(yv));
+        }
+        for (; j < j1; j++)
+            y[j] += static_cast<double>(row[j]) * x[i];
+    }
+}
+
+// Y[i0 + r, k0:k0 + kc] += A[i0 + r, j0:j1] * X[j0:j1, k0:k0 + kc] for r < R,
+// with kc <= KB * GEMV_LANES. The accumulators stay in registers; lanes past
+// kc read the padding of X's rows and are dropped on the store.
+template <int R, int KB>
+__attribute__((always_inline)) inline void batch_block(const double* a, long ld, const double* x, long ldx,
+                                                       double* y, long ldy, long j0, long j1, int kc) {
+    vec acc[R][KB] = {};
+    vec xv[KB];
+    for (long j = j0; j < j1; j++) {
+#pragma GCC unroll 4
+        for (int b = 0; b < KB; b++)
+            std::memcpy(&xv[b], x + j * ldx + b * GEMV_LANES, sizeof(vec));
+#pragma GCC unroll 8
+        for (int r = 0; r < R; r++) {
+            vec ar = {};
+            ar += a[r * ld + j];
+#pragma GCC unroll 4
+            for (int b = 0; b < KB; b++)
+                acc[r][b] += ar * xv[b];
+        }
+    }
+    for (int r = 0; r < R; r++)
+        for (int b = 0; b < KB; b++) {
+            int lanes = std::min(GEMV_LANES, kc - b * GEMV_LANES);
+            vec yv;
+            std::memcpy(&yv, y + r * ldy + b * GEMV_LANES, lanes * sizeof(double));
+            yv += acc[r][b];
+            std::memcpy(y + r * ldy + b * GEMV_LANES, &yv, lanes * sizeof(double));
+        }
+}
+
+// Rows [i0, i1) of the batched product over the x tile [j0, j1) and the
+// right-hand sides [k0, k0 + kc), kc <= GEMV_BATCH. Narrow panels take more
+// rows so there are always about 8 independent accumulator chains; the
+// pragmas make GCC unroll the fixed-size loops at -O2 so the accumulator
+// arrays live in registers.
+template <int KB>
+__attribute__((always_inline)) inline void batch_panel(const double* a, long ld, const double* x, long ldx,
+                                                       double* y, long ldy, long i0, long i1, long j0, long j1, int kc) {
+    const int rows = KB == 1 ? 8 : KB == 2 ? 4 : 2;
+    long i = i0;
+    for (; i + rows <= i1; i += rows)
+        batch_block<rows, KB>(a + i * ld, ld, x, ldx, y + i * ldy, ldy, j0, j1, kc);
+    for (; i < i1; i++)
+        batch_block<1, KB>(a + i * ld, ld, x, ldx, y + i * ldy, ldy, j0, j1, kc);
+}
+
+__attribute__((target_clones("arch=x86-64-v4", "arch=x86-64-v3", "default")))
+static void batch_tile(const double* a, long ld, const double* x, long ldx, double* y, long ldy,
+                       long i0, long i1, long j0, long j1, int kc) {
+    switch ((kc + GEMV_LANES - 1) / GEMV_LANES) {
+        case 1: batch_panel<1>(a, ld, x, ldx, y, ldy, i0, i1, j0, j1, kc); break;
+        case 2: batch_panel<2>(a, ld, x, ldx, y, ldy, i0, i1, j0, j1, kc); break;
+        case 3: batch_panel<3>(a, ld, x, ldx, y, ldy, i0, i1, j0, j1, kc); break;
+        default: batch_panel<4>(a, ld, x, ldx, y, ldy, i0, i1, j0, j1, kc); break;
+    }
+}
+
+// Rows of this thread: contiguous blocks of whole GEMV_ROWS groups, one per
+// thread of the enclosing OpenMP team.
+inline void thread_rows(long rows, long& i0, long& i1) {
+    long groups = (rows + GEMV_ROWS - 1) / GEMV_ROWS;
+    long threads = omp_get_num_threads();
+    long t = omp_get_thread_num();
+    i0 = std::min(rows, groups * t / threads * GEMV_ROWS);
+    i1 = std::min(rows, groups * (t + 1) / threads * GEMV_ROWS);
+}
+
+// Columns of this thread: contiguous blocks of whole cache lines of y.
+inline void thread_cols(long cols, long& j0, long& j1) {
+    long lines = (cols + GEMV_LANES - 1) / GEMV_LANES;
+    long threads = omp_get_num_threads();
+    long t = omp_get_thread_num();
+    j0 = std::min(cols, lines * t / threads * GEMV_LANES);
+    j1 = std::min(cols, lines * (t + 1) / threads * GEMV_LANES);
+}
+
+} // namespace gemv_detail
+
+
+// y[i] = A[i, :] . x for i in [i0, i1); y must hold at least i1 elements.
+// The view form takes rows that live elsewhere, e.g. a panel of a mapped
+// file (out_of_core.h).
+template <typename T>
+void gemv_rows(const MatrixView<const T>& matrix, const double* x, double* y, long i0, long i1) {
+    const long n = matrix.cols;
+    std::fill(y + i0, y + i1, 0.0);
+    for (long j0 = 0; j0 < n; j0 += GEMV_TILE)
+        gemv_detail::gemv_tile(matrix.ptr, matrix.ld, x, y, i0, i1, j0, std::min(n, j0 + GEMV_TILE));
+}
+
+template <typename T>
+void gemv_rows(const Matrix<T>& matrix, const double* x, double* y, long i0, long i1) {
+    gemv_rows(matrix.view(), x, y, i0, i1);
+}
+
+// All rows, split into contiguous blocks of whole row groups per thread of
+// the enclosing OpenMP team size.
+template <typename T>
+void gemv_parallel(const MatrixView<const T>& matrix, const double* x, double* y) {
+#pragma omp parallel
+    {
+        long i0, i1;
+        gemv_detail::thread_rows(matrix.rows, i0, i1);
+        if (i0 < i1)
+            gemv_rows(matrix, x, y, i0, i1);
+    }
+}
+
+template <typename T>
+void gemv_parallel(const Matrix<T>& matrix, const double* x, double* y) {
+    gemv_parallel(matrix.view(), x, y);
+}
+
+// y[j] = A[:, j] . x for j in [j0, j1), i.e. columns of A^T*x; x has
+// matrix.rows elements, y at least j1.
+template <typename T>
+void gemv_transposed_cols(const MatrixView<const T>& matrix, const double* x, double* y, long j0, long j1) {
+    std::fill(y + j0, y + j1, 0.0);
+    for (long c0 = j0; c0 < j1; c0 += GEMV_TRANSPOSED_TILE)
+        gemv_detail::gemv_transposed_tile(matrix.ptr, matrix.ld, matrix.rows, x, y, c0,
+                                          std::min(j1, c0 + GEMV_TRANSPOSED_TILE));
+}
+
+template <typename T>
+void gemv_transposed_cols(const Matrix<T>& matrix, const double* x, double* y, long j0, long j1) {
+    gemv_transposed_cols(matrix.view(), x, y, j0, j1);
+}
+
+// y = A^T*x, columns split into contiguous blocks of whole cache lines per
+// thread of the enclosing OpenMP team size.
+template <typename T>
+void gemv_transposed_parallel(const MatrixView<const T>& matrix, const double* x, double* y) {
+#pragma omp parallel
+    {
+        long j0, j1;
+        gemv_detail::thread_cols(matrix.cols, j0, j1);
+        if (j0 < j1)
+            gemv_transposed_cols(matrix, x, y, j0, j1);
+    }
+}
+
+template <typename T>
+void gemv_transposed_parallel(const Matrix<T>& matrix, const double* x, double* y) {
+    gemv_transposed_parallel(matrix.view(), x, y);
+}
+
+// Y[i, :] = A[i, :] * X for i in [i0, i1), where column c of X (cols x k) is
+// the c-th right-hand side and Y must have k columns. The x tile shrinks with
+// k so a tile of X rows still fits in L2; right-hand sides beyond
+// GEMV_BATCH are handled in further panels over the same A rows, which are
+// still in cache from the previous panel.
+inline void gemv_batch_rows(const Matrix<double>& matrix, const Matrix<double>& x, Matrix<double>& y, long i0, long i1) {
+    const long n = matrix.cols();
+    const int k = static_cast<int>(x.cols());
+    if (k == 1) {
+        // a single right-hand side gains nothing from broadcasting; use the
+        // dot-product kernel on a contiguous copy of the column
+        std::vector<double> x1(n), y1(i1);
+        for (long j = 0; j < n; j++)
+            x1[j] = x(j, 0);
+        gemv_rows(matrix, x1.data(), y1.data(), i0, i1);
+        for (long i = i0; i < i1; i++)
+            y(i, 0) = y1[i];
+        return;
+    }
+    const long tile = std::max<long>(GEMV_ROWS, GEMV_TILE / static_cast<long>(x.ld()));
+    for (long i = i0; i < i1; i++)
+        std::fill(y.row(i).begin(), y.row(i).end(), 0.0);
+    for (long j0 = 0; j0 < n; j0 += tile) {
+        long j1 = std::min(n, j0 + tile);
+        for (long r0 = i0; r0 < i1; r0 += 2 * GEMV_ROWS) {
+            long r1 = std::min(i1, r0 + 2 * GEMV_ROWS);
+            for (int k0 = 0; k0 < k; k0 += GEMV_BATCH)
+                gemv_detail::batch_tile(matrix.data(), matrix.ld(), x.data() + k0, x.ld(), y.data() + k0, y.ld(),
+                                        r0, r1, j0, j1, std::min(GEMV_BATCH, k - k0));
+        }
+    }
+}
+
+// Batched counterpart of gemv_parallel, with the same row split.
+inline void gemv_batch_parallel(const Matrix<double>& matrix, const Matrix<double>& x, Matrix<double>& y) {
+#pragma omp parallel
+    {
+        long i0, i1;
+        gemv_detail::thread_rows(matrix.rows(), i0, i1);
+        if (i0 < i1)
+            gemv_batch_rows(matrix, x, y, i0, i1);
+    }
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// The test matrix of main.cpp, A[i][j] = i + j, n x n, and its product with
+// x = 1 for checking the benches that multiply it.
+
+inline double ij_element(long i, long j) { return static_cast<double>(i + j); }
+
+// y[i] of A times x = 1: n * i + n * (n - 1) / 2
+inline double ij_row_sum(long i, long n) { return static_cast<double>(n) * i + 0.5 * n * (n - 1); }
+
+// largest relative error of y against A times x = 1
+inline double ij_max_error(const std::vector<double>& y, long n) {
+    double worst = 0.0;
+    for (long i = 0; i < n; i++) {
+        double exact = ij_row_sum(i, n);
+        worst = std::max(worst, std::fabs(y[i] - exact) / exact);
+    }
+    return worst;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <omp.h>
+
+// A matrix whose elements are computed from their indices instead of being
+// stored. The generator is a template parameter, so the multiply kernels
+// below inline its formula and the only memory traffic is x and y:
+//
+//   ImplicitMatrix<double, IndexSum> a(n, n);    // a(i, j) = i + j
+//   gemv_parallel(a, x, y);
+//
+// A generator is any copyable type with
+//
+//   T operator()(long i, long j) const;
+//
+// Keep it free of branches on j where possible, the row loop is vectorized
+// across j. Like the stored kernels in gemv.h it is cloned for AVX-512,
+// AVX2 and baseline x86-64; index-to-double conversions in particular are
+// only vector instructions on AVX-512.
+
+template <typename T, typename Gen>
+class ImplicitMatrix {
+public:
+    ImplicitMatrix(std::size_t rows, std::size_t cols, Gen gen = Gen()) : rows_(rows), cols_(cols), gen_(gen) {}
+
+    std::size_t rows() const { return rows_; }
+    std::size_t cols() const { return cols_; }
+    const Gen& generator() const { return gen_; }
+
+    T operator()(long i, long j) const { return gen_(i, j); }
+
+private:
+    std::size_t rows_, cols_;
+    Gen gen_;
+};
+
+// matrix[i][j] = i + j, as init() in main.cpp fills it
+struct IndexSum {
+    double operator()(long i, long j) const { return static_cast<double>(i + j); }
+};
+
+
+// y[i] = A[i, :] . x for i in [i0, i1)
+template <typename T, typename Gen>
+__attribute__((target_clones("arch=x86-64-v4", "arch=x86-64-v3", "default")))
+void gemv_rows(const ImplicitMatrix<T, Gen>& matrix, const T* x, T* y, long i0, long i1) {
+    const long n = matrix.cols();
+    const Gen gen = matrix.generator();
+    for (long i = i0; i < i1; i++) {
+        T sum = 0;
+#pragma omp simd reduction(+:sum)
+        for (long j = 0; j < n; j++)
+            sum += gen(i, j) * x[j];
+        y[i] = sum;
+    }
+}
+
+// All rows, one contiguous block per thread of the enclosing OpenMP team.
+template <typename T, typename Gen>
+void gemv_parallel(const ImplicitMatrix<T, Gen>& matrix, const T* x, T* y) {
+    const long rows = matrix.rows();
+#pragma omp parallel
+    {
+        long threads = omp_get_num_threads();
+        long t = omp_get_thread_num();
+        gemv_rows(matrix, x, y, rows * t / threads, rows * (t + 1) / threads);
+    }
+}
@@ -1,7 +1,13 @@
 #include <iostream>
 #include <omp.h>
 #include <vector>
-#include <chrono>
+#include "matrix.h"
+#include "structured.h"
+#include "autotune.h"
+#include "affinity.h"
+#include "bench.h"
+#include "perf_counters.h"
+#include "roofline.h"
 
 /*
 std::string executeCommand(const std::string& command) {
@@ -18,27 +24,36 @@ std::string executeCommand(const std::string& command) {
 }
 */
 
-void init(std::vector<std::vector<double>>& matrix, std::vector<double>& vector, int matrix_size) {
-#pragma omp parallel for
+// schedule(static): the rows a thread writes first are placed on its node
+void init(Matrix<double>& matrix, std::vector<double>& vector, int matrix_size) {
+#pragma omp parallel for schedule(static)
     for (int i = 0; i < matrix_size; i++) {
+        Span<double> row = matrix.row(i);
         for (int j = 0; j < matrix_size; j++)
-            matrix[i][j] = i + j;
+            row[j] = i + j;
         vector[i] = i;
     }
 }
 
-void multiplication(int num_threads, std::vector<std::vector<double>> matrix, std::vector<double> vector, int threads) {
-#pragma omp parallel num_threads(threads)
-    {
-#pragma omp for schedule(guided)
-        for (int i = 0; i < matrix.size(); i++) {
-            for (int j = 0; j < matrix.size(); j++) {
-                matrix[i][j] *= vector[j];
-            }
+// schedule(runtime): the kind and chunk come from the autotuner. The
+// product goes to `result`, so repeated runs see the same input instead of
+// multiplying it up to inf.
+void multiplication(const Matrix<double>& matrix, const std::vector<double>& vector, Matrix<double>& result) {
+#pragma omp parallel for schedule(runtime)
+    for (int i = 0; i < matrix.rows(); i++) {
+        Span<const double> row = matrix.row(i);
+        Span<double> out = result.row(i);
+        for (int j = 0; j < matrix.cols(); j++) {
+            out[j] = row[j] * vector[j];
         }
     }
 }
 
+// A * diag(vector) of a low-rank A = U * V^T, in O(n * rank)
+LowRankMatrix multiplication(const LowRankMatrix& matrix, const std::vector<double>& vector) {
+    return matrix.scale_columns(vector.data());
+}
+
 int main() {
     /*
     std::string cpuInfo = executeCommand("lscpu");
@@ -56,51 +71,64 @@ int main() {
 
     std::vector<int> num_threads = {1, 2, 4, 7, 8, 16, 20, 40};
     std::vector<int> matrix_sizes = {20000, 40000};
-    std::vector<std::vector<double>> runtimes(num_threads.size(), std::vector<double>(matrix_sizes.size()));
-    std::vector<std::vector<double>> speedups(num_threads.size(), std::vector<double>(matrix_sizes.size()));
+
+    Affinity affinity = affinity_from_env();
+    std::cout << "Affinity: " << affinity_name(affinity) << " (" << omp_environment(affinity, omp_get_num_procs()) << ")" << std::endl << std::endl;
+
+    // tuned once per size, then loaded from the tuning file on later runs
+    Autotuner tuner;
+    std::vector<TuneConfig> tuned(matrix_sizes.size());
+    // the structure of each size, detected on the first pass; a low-rank
+    // matrix is also scaled as its factors, next to the dense kernel
+    std::vector<Structure> structure(matrix_sizes.size(), Structure::Dense);
+    std::vector<LowRankMatrix> factors(matrix_sizes.size());
+    Sweep sweep("lab2/1 scale_rows");
 
     for (int i = 0; i < num_threads.size(); i++) {
         for (int j = 0; j < matrix_sizes.size(); j++) {
             int threads = num_threads[i];
             int matrix_size = matrix_sizes[j];
 
-            // omp_set_num_threads(threads);
-
-            std::vector<std::vector<double>> matrix(matrix_size, std::vector<double>(matrix_size));
+            Matrix<double> matrix(matrix_size, matrix_size), result(matrix_size, matrix_size);
             std::vector<double> vector(matrix_size);
 
-            init(matrix, vector, matrix_size);
-
-            auto start_time = std::chrono::high_resolution_clock::now();
-
-#pragma omp parallel num_threads(threads)
-            {
-#pragma omp for schedule(guided)
-                for (int q = 0; q < matrix_size; q++)
-                    for (int w = 0; w < matrix_size; w++)
-                        matrix[q][w] *= vector[w];
+            if (i == 0) {
+                init(matrix, vector, matrix_size);
+                tuned[j] = tuner.tune("scale_rows", matrix_size, [&] { multiplication(matrix, vector, result); });
+                StructuredMatrix<Matrix<double>> structured(matrix);
+                structure[j] = structured.structure();
+                std::cout << "matrix size " << matrix_size << ": " << structure_name(structure[j]) << std::endl;
+                if (structure[j] == Structure::LowRank)
+                    factors[j] = structured.low_rank();
             }
 
-//            multiplication(threads, matrix, vector, threads);
-
-            auto end_time = std::chrono::high_resolution_clock::now();
-            double runtime = std::chrono::duration<double>(end_time - start_time).count();
-
-            runtimes[i][j] = runtime;
+            // one multiply per element, read from the matrix and written to the result
+            sweep.annotate(1.0 * matrix_size * matrix_size, 16.0 * matrix_size * matrix_size + 8.0 * matrix_size);
+            omp_set_num_threads(threads);
+            bind_omp_threads(affinity, threads);
+            omp_set_schedule(tuned[j].kind, tuned[j].chunk);
+            init(matrix, vector, matrix_size);
 
-            double speedup;
-            j == 1 ? speedup = runtimes[0][1] / runtime : speedup = runtimes[0][0] / runtime;
-            speedups[i][j] = speedup;
+            sweep.run("scale_rows", matrix_size, threads, [&] { multiplication(matrix, vector, result); }, omp_placement(threads),
+                      TeamCounters(threads));
 
-            std::cout << "Runtime with " << threads << " threads and matrix size " << matrix_size << ": " << runtime << " seconds" << std::endl;
-            std::cout << "Speedup with " << threads << " threads and matrix size " << matrix_size << ": " << speedup << std::endl << std::endl;
+            if (structure[j] == Structure::LowRank) {
+                LowRankMatrix scaled;
+                sweep.annotate(0.0, 0.0);
+                sweep.run("scale_rows low-rank", matrix_size, threads, [&] { scaled = multiplication(factors[j], vector); },
+                          omp_placement(threads), TeamCounters(threads));
+            }
         }
     }
 
-    std::cout << "Summary:" << std::endl;
-    for (int i = 0; i < num_threads.size(); i++)
-        for (int j = 0; j < matrix_sizes.size(); j++)
-            std::cout << num_threads[i] << " threads and matrix size " << matrix_sizes[j] << ": S = " << speedups[i][j] << ", T = " << runtimes[i][j] << std::endl;
+    sweep.print_summary();
+    sweep.save();
+    if (roofline_mode())
+        print_roofline(sweep.records());
+
+    std::cout << std::endl << "Tuned (" << tuner.path() << "):" << std::endl;
+    for (int j = 0; j < matrix_sizes.size(); j++)
+        std::cout << "matrix size " << matrix_sizes[j] << ": schedule(" << schedule_name(tuned[j].kind) << ", " << tuned[j].chunk << "), " << tuned[j].threads << " threads, T = " << tuned[j].seconds << std::endl;
 
     return 0;
 }
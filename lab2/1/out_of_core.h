@@ -0,0 +1,314 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <unistd.h>
+#include "matrix.h"
+#include "gemv.h"
+
+// y = A*x for a dense matrix of doubles stored in a file, including files
+// larger than memory (n = 400000 is 1.28 TB).
+//
+// File layout: one 4 KiB header page, then the rows back to back with no
+// padding, so every panel of whole rows is one contiguous byte range.
+//
+//   if (!matrix_file_matches("a.bin", n, n))
+//       write_matrix_file("a.bin", n, n, [](long i, long j) { return i + j; });
+//   OutOfCoreGemv a("a.bin");          // Auto: checks the available memory
+//   a.multiply(x, y);
+//
+// Modes:
+//   InMemory  the file fits comfortably: it is read once into a Matrix and
+//             every multiply is the ordinary gemv_parallel
+//   Mapped    the file is mmapped; before a panel is multiplied the next one
+//             is requested with madvise(MADV_WILLNEED), which starts
+//             asynchronous readahead, and pages of finished panels are
+//             dropped from the mapping and the page cache
+//   Streamed  two panel buffers: a reader thread preads panel p + 1 into one
+//             while the OpenMP team multiplies panel p from the other, so
+//             memory use is two panels whatever the matrix size
+//
+// Auto picks InMemory when the matrix takes less than MEMORY_FRACTION of
+// the available memory (MemAvailable, or the cgroup limit if lower), and
+// Streamed otherwise. Panels are OOC_PANEL_BYTES of whole rows.
+
+const std::size_t MATRIX_FILE_HEADER = 4096;
+const std::size_t OOC_PANEL_BYTES = 64 << 20;
+const double MEMORY_FRACTION = 0.5;
+
+enum class OutOfCoreMode {
+    Auto,
+    InMemory,
+    Mapped,
+    Streamed
+};
+
+inline const char* mode_name(OutOfCoreMode mode) {
+    switch (mode) {
+        case OutOfCoreMode::InMemory: return "in-memory";
+        case OutOfCoreMode::Mapped: return "mapped";
+        case OutOfCoreMode::Streamed: return "streamed";
+        default: return "auto";
+    }
+}
+
+
+namespace out_of_core_detail {
+
+const char MAGIC[8] = {'G', 'E', 'M', 'V', 'F', '6', '4', '\0'};
+
+struct Header {
+    char magic[8];
+    std::uint64_t rows, cols;
+};
+
+// pread until `bytes` are in or the file ends
+inline bool read_fully(int fd, void* buffer, std::size_t bytes, off_t offset) {
+    char* p = static_cast<char*>(buffer);
+    while (bytes > 0) {
+        ssize_t got = pread(fd, p, bytes, offset);
+        if (got <= 0)
+            return false;
+        p += got;
+        bytes -= got;
+        offset += got;
+    }
+    return true;
+}
+
+// /proc/meminfo value in bytes, 0 if missing
+inline std::size_t meminfo(const std::string& key) {
+    std::ifstream file("/proc/meminfo");
+    std::string name;
+    std::size_t kb;
+    while (file >> name >> kb) {
+        if (name == key + ":")
+            return kb << 10;
+        file.ignore(1 << 10, '\n');
+    }
+    return 0;
+}
+
+// bytes free for an unprivileged user on the file system that holds `path`,
+// counting the space of `path` itself, which is about to be truncated
+inline std::size_t free_disk(const std::string& path) {
+    std::size_t slash = path.rfind('/');
+    std::string dir = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+    struct statvfs fs;
+    if (statvfs(dir.c_str(), &fs) != 0)
+        return 0;
+    std::size_t free = static_cast<std::size_t>(fs.f_bavail) * fs.f_frsize;
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0)
+        free += st.st_size;
+    return free;
+}
+
+} // namespace out_of_core_detail
+
+
+// Bytes this process can still allocate without swapping or hitting its
+// cgroup limit.
+inline std::size_t available_memory() {
+    std::size_t available = out_of_core_detail::meminfo("MemAvailable");
+    std::ifstream max_file("/sys/fs/cgroup/memory.max"), current_file("/sys/fs/cgroup/memory.current");
+    std::size_t limit, current;
+    if (max_file >> limit && current_file >> current)  // "max" fails to parse: no limit
+        available = std::min(available, limit > current ? limit - current : 0);
+    return available;
+}
+
+// Whether `path` is a rows x cols matrix file: the header and the file size
+// are checked, the elements are not read.
+inline bool matrix_file_matches(const std::string& path, std::size_t rows, std::size_t cols) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 ||
+        static_cast<std::size_t>(st.st_size) != MATRIX_FILE_HEADER + rows * cols * sizeof(double))
+        return false;
+    std::ifstream file(path, std::ios::binary);
+    out_of_core_detail::Header h;
+    return file.read(reinterpret_cast<char*>(&h), sizeof(h)) &&
+           std::memcmp(h.magic, out_of_core_detail::MAGIC, sizeof(h.magic)) == 0 && h.rows == rows && h.cols == cols;
+}
+
+// Writes gen(i, j) panel by panel, so matrices larger than memory can be
+// generated. Refuses up front when the file system has no room for the
+// whole file, rather than filling it and failing halfway.
+template <typename Gen>
+void write_matrix_file(const std::string& path, std::size_t rows, std::size_t cols, Gen gen,
+                       std::size_t panel_bytes = OOC_PANEL_BYTES) {
+    const std::size_t needed = MATRIX_FILE_HEADER + rows * cols * sizeof(double);
+    const std::size_t free = out_of_core_detail::free_disk(path);
+    if (needed > free)
+        throw std::runtime_error("write_matrix_file: " + path + " needs " + std::to_string(needed >> 20) +
+                                 " MB, " + std::to_string(free >> 20) + " MB free");
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    char header[MATRIX_FILE_HEADER] = {};
+    out_of_core_detail::Header h;
+    std::memcpy(h.magic, out_of_core_detail::MAGIC, sizeof(h.magic));
+    h.rows = rows;
+    h.cols = cols;
+    std::memcpy(header, &h, sizeof(h));
+    file.write(header, sizeof(header));
+
+    const std::size_t panel_rows = std::max<std::size_t>(1, panel_bytes / (cols * sizeof(double)));
+    std::vector<double> panel(panel_rows * cols);
+    for (std::size_t r0 = 0; r0 < rows; r0 += panel_rows) {
+        const std::size_t r1 = std::min(rows, r0 + panel_rows);
+#pragma omp parallel for schedule(static)
+        for (long i = r0; i < static_cast<long>(r1); i++)
+            for (std::size_t j = 0; j < cols; j++)
+                panel[(i - r0) * cols + j] = gen(i, static_cast<long>(j));
+        file.write(reinterpret_cast<const char*>(panel.data()), (r1 - r0) * cols * sizeof(double));
+    }
+    if (!file)
+        throw std::runtime_error("write_matrix_file: cannot write " + path);
+}
+
+
+class OutOfCoreGemv {
+public:
+    explicit OutOfCoreGemv(const std::string& path, OutOfCoreMode mode = OutOfCoreMode::Auto,
+                           std::size_t panel_bytes = OOC_PANEL_BYTES) {
+        fd_ = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd_ < 0)
+            throw std::runtime_error("OutOfCoreGemv: cannot open " + path);
+        out_of_core_detail::Header h;
+        if (!out_of_core_detail::read_fully(fd_, &h, sizeof(h), 0) ||
+            std::memcmp(h.magic, out_of_core_detail::MAGIC, sizeof(h.magic)) != 0)
+            fail(path + " is not a matrix file");
+        rows_ = h.rows;
+        cols_ = h.cols;
+        panel_rows_ = std::max<std::size_t>(1, panel_bytes / row_bytes());
+        if (mode == OutOfCoreMode::Auto)
+            mode = bytes() < MEMORY_FRACTION * available_memory() ? OutOfCoreMode::InMemory : OutOfCoreMode::Streamed;
+        mode_ = mode;
+
+        if (mode_ == OutOfCoreMode::InMemory) {
+            matrix_ = Matrix<double>(rows_, cols_);
+            for (std::size_t i = 0; i < rows_; i++)
+                if (!out_of_core_detail::read_fully(fd_, matrix_.row(i).data(), row_bytes(), offset(i)))
+                    fail(path + " is truncated");
+        } else if (mode_ == OutOfCoreMode::Mapped) {
+            void* map = mmap(nullptr, MATRIX_FILE_HEADER + bytes(), PROT_READ, MAP_SHARED, fd_, 0);
+            if (map == MAP_FAILED)
+                fail("cannot map " + path);
+            map_ = static_cast<const char*>(map);
+        } else {
+            posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+            for (std::vector<double>& buffer : buffers_)
+                buffer.resize(panel_rows_ * cols_);
+        }
+    }
+
+    ~OutOfCoreGemv() {
+        if (map_)
+            munmap(const_cast<char*>(map_), MATRIX_FILE_HEADER + bytes());
+        close(fd_);
+    }
+
+    OutOfCoreGemv(const OutOfCoreGemv&) = delete;
+    OutOfCoreGemv& operator=(const OutOfCoreGemv&) = delete;
+
+    std::size_t rows() const { return rows_; }
+    std::size_t cols() const { return cols_; }
+    std::size_t bytes() const { return rows_ * row_bytes(); }
+    OutOfCoreMode mode() const { return mode_; }
+
+    // Seconds the last streamed multiply spent waiting for the reader after
+    // finishing a panel; near 0 when I/O fully overlaps compute. (Mapped
+    // mode waits inside page faults, which only the wall time shows.)
+    double io_wait() const { return io_wait_; }
+
+    // y = A*x with the team of the enclosing OpenMP setting.
+    void multiply(const double* x, double* y) {
+        io_wait_ = 0.0;
+        if (mode_ == OutOfCoreMode::InMemory)
+            gemv_parallel(matrix_, x, y);
+        else if (mode_ == OutOfCoreMode::Mapped)
+            multiply_mapped(x, y);
+        else
+            multiply_streamed(x, y);
+    }
+
+private:
+    std::size_t row_bytes() const { return cols_ * sizeof(double); }
+    off_t offset(std::size_t row) const { return MATRIX_FILE_HEADER + row * row_bytes(); }
+    std::size_t panel_end(std::size_t r0) const { return std::min(rows_, r0 + panel_rows_); }
+
+    [[noreturn]] void fail(const std::string& message) {
+        close(fd_);
+        throw std::runtime_error("OutOfCoreGemv: " + message);
+    }
+
+    // madvise needs a page-aligned start; round it down
+    void advise(std::size_t begin, std::size_t end, int advice) const {
+        const std::size_t page = sysconf(_SC_PAGESIZE);
+        begin = begin / page * page;
+        if (end > begin)
+            madvise(const_cast<char*>(map_) + begin, end - begin, advice);
+    }
+
+    void multiply_mapped(const double* x, double* y) {
+        const std::size_t page = sysconf(_SC_PAGESIZE);
+        advise(offset(0), offset(panel_end(0)), MADV_WILLNEED);
+        for (std::size_t r0 = 0; r0 < rows_; r0 += panel_rows_) {
+            const std::size_t r1 = panel_end(r0);
+            if (r1 < rows_)
+                advise(offset(r1), offset(panel_end(r1)), MADV_WILLNEED);
+            const double* panel = reinterpret_cast<const double*>(map_ + offset(r0));
+            gemv_parallel(MatrixView<const double>{panel, r1 - r0, cols_, cols_}, x, y + r0);
+            // drop the finished panel, except the page it may share with the next
+            const std::size_t begin = offset(r0) / page * page, end = offset(r1) / page * page;
+            if (end > begin) {
+                advise(begin, end, MADV_DONTNEED);
+                posix_fadvise(fd_, begin, end - begin, POSIX_FADV_DONTNEED);
+            }
+        }
+    }
+
+    void multiply_streamed(const double* x, double* y) {
+        bool ok = out_of_core_detail::read_fully(fd_, buffers_[0].data(), panel_end(0) * row_bytes(), offset(0));
+        int current = 0;
+        for (std::size_t r0 = 0; r0 < rows_ && ok; r0 += panel_rows_) {
+            const std::size_t r1 = panel_end(r0);
+            bool next_ok = true;
+            std::thread reader;
+            if (r1 < rows_)
+                reader = std::thread([&, r1] {
+                    next_ok = out_of_core_detail::read_fully(fd_, buffers_[1 - current].data(), (panel_end(r1) - r1) * row_bytes(), offset(r1));
+                });
+            gemv_parallel(MatrixView<const double>{buffers_[current].data(), r1 - r0, cols_, cols_}, x, y + r0);
+            posix_fadvise(fd_, offset(r0), (r1 - r0) * row_bytes(), POSIX_FADV_DONTNEED);
+            if (reader.joinable()) {
+                auto start_time = std::chrono::high_resolution_clock::now();
+                reader.join();
+                auto end_time = std::chrono::high_resolution_clock::now();
+                io_wait_ += std::chrono::duration<double>(end_time - start_time).count();
+            }
+            ok = next_ok;
+            current = 1 - current;
+        }
+        if (!ok)
+            throw std::runtime_error("OutOfCoreGemv: short read");
+    }
+
+    int fd_ = -1;
+    std::size_t rows_ = 0, cols_ = 0, panel_rows_ = 1;
+    OutOfCoreMode mode_ = OutOfCoreMode::InMemory;
+    Matrix<double> matrix_;
+    const char* map_ = nullptr;
+    std::vector<double> buffers_[2];
+    double io_wait_ = 0.0;
+};
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <omp.h>
+#include "bfloat16.h"
+#include "matrix.h"
+#include "gemv.h"
+
+// Reduced-precision copies of a Matrix<double> for bandwidth-bound GEMV.
+// The kernels in gemv.h read Matrix<float> and Matrix<bfloat16> directly;
+// Int8Matrix adds one scale per row:
+//
+//   A[i][j] ~ scales[i] * values(i, j),  scales[i] = max_j |A[i][j]| / 127
+//
+// so y[i] = scales[i] * (values[i, :] . x) with the dot product in double.
+// Conversions fill rows with the same split as gemv_parallel, so first touch
+// puts each row next to the thread that later reads it.
+
+struct Int8Matrix {
+    Matrix<int8_t> values;
+    std::vector<double> scales;
+
+    std::size_t rows() const { return values.rows(); }
+    std::size_t cols() const { return values.cols(); }
+};
+
+// T(A[i][j]) elementwise: float rounds to nearest, bfloat16 to nearest even
+template <typename T>
+Matrix<T> convert_matrix(const Matrix<double>& matrix) {
+    Matrix<T> result(matrix.rows(), matrix.cols());
+#pragma omp parallel
+    {
+        long i0, i1;
+        gemv_detail::thread_rows(matrix.rows(), i0, i1);
+        for (long i = i0; i < i1; i++) {
+            Span<const double> src = matrix.row(i);
+            Span<T> dst = result.row(i);
+            for (std::size_t j = 0; j < src.size(); j++)
+                dst[j] = static_cast<T>(static_cast<float>(src[j]));
+        }
+    }
+    return result;
+}
+
+template <>
+inline Matrix<double> convert_matrix<double>(const Matrix<double>& matrix) {
+    return matrix;
+}
+
+inline Int8Matrix quantize_int8(const Matrix<double>& matrix) {
+    Int8Matrix q{Matrix<int8_t>(matrix.rows(), matrix.cols()), std::vector<double>(matrix.rows())};
+#pragma omp parallel
+    {
+        long i0, i1;
+        gemv_detail::thread_rows(matrix.rows(), i0, i1);
+        for (long i = i0; i < i1; i++) {
+            Span<const double> src = matrix.row(i);
+            Span<int8_t> dst = q.values.row(i);
+            double peak = 0.0;
+            for (double v : src)
+                peak = std::max(peak, std::abs(v));
+            double scale = peak > 0.0 ? peak / 127 : 1.0;
+            for (std::size_t j = 0; j < src.size(); j++)
+                dst[j] = static_cast<int8_t>(std::lround(src[j] / scale));
+            q.scales[i] = scale;
+        }
+    }
+    return q;
+}
+
+inline Matrix<double> dequantize(const Int8Matrix& q) {
+    Matrix<double> result(q.rows(), q.cols());
+    for (std::size_t i = 0; i < q.rows(); i++)
+        for (std::size_t j = 0; j < q.cols(); j++)
+            result(i, j) = q.scales[i] * q.values(i, j);
+    return result;
+}
+
+
+inline void gemv_rows(const Int8Matrix& matrix, const double* x, double* y, long i0, long i1) {
+    gemv_rows(matrix.values, x, y, i0, i1);
+    for (long i = i0; i < i1; i++)
+        y[i] *= matrix.scales[i];
+}
+
+inline void gemv_parallel(const Int8Matrix& matrix, const double* x, double* y) {
+#pragma omp parallel
+    {
+        long i0, i1;
+        gemv_detail::thread_rows(matrix.rows(), i0, i1);
+        if (i0 < i1)
+            gemv_rows(matrix, x, y, i0, i1);
+    }
+}
+
+
+// ||y - reference|| / ||reference|| in the 2-norm and the largest element
+// error relative to the largest reference element
+struct RelativeError {
+    double norm, max;
+};
+
+inline RelativeError relative_error(const std::vector<double>& y, const std::vector<double>& reference) {
+    double diff2 = 0.0, ref2 = 0.0, diff_max = 0.0, ref_max = 0.0;
+    for (std::size_t i = 0; i < y.size(); i++) {
+        double d = y[i] - reference[i];
+        diff2 += d * d;
+        ref2 += reference[i] * reference[i];
+        diff_max = std::max(diff_max, std::abs(d));
+        ref_max = std::max(ref_max, std::abs(reference[i]));
+    }
+    return {std::sqrt(diff2 / std::max(ref2, 1e-300)), diff_max / std::max(ref_max, 1e-300)};
+}
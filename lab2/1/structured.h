@@ -0,0 +1,406 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+#include <omp.h>
+#include "matrix.h"
+
+// Matrices with structure that makes y = A*x cheaper than O(rows * cols):
+//
+//   ToeplitzMatrix  A[i][j] = t[i - j], applied by circulant embedding and
+//                   FFT in O(L log L), L the power of two >= rows + cols - 1
+//   HankelMatrix    A[i][j] = h[i + j], a Toeplitz matrix applied to x
+//                   reversed
+//   LowRankMatrix   A = U * V^T with U rows x r and V cols x r, O(r (rows + cols))
+//
+// StructuredMatrix<M> inspects any M with rows(), cols() and operator()(i, j)
+// (Matrix<double>, ImplicitMatrix) once and keeps the cheapest exact
+// representation it finds; its gemv_parallel overload then goes to the fast
+// path, or to the source's own gemv_parallel when nothing matched. The
+// entry points of test2.cpp and main.cpp detect once per matrix and
+// dispatch through it; the drivers run the dense kernels as well, through
+// StructuredMatrix::dense.
+
+namespace structured_detail {
+
+typedef std::complex<double> complex;
+
+// spelled out: operator* on std::complex calls __muldc3 for inf/NaN handling
+inline complex mul(complex a, complex b) {
+    return {a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real()};
+}
+
+// Iterative radix-2 FFT of one power-of-two size with tabulated twiddles.
+class Fft {
+public:
+    Fft() = default;
+
+    explicit Fft(std::size_t size) : size_(size), twiddle_(size / 2), reversed_(size) {
+        const double pi = std::acos(-1.0);
+        for (std::size_t k = 0; k < size / 2; k++)
+            twiddle_[k] = std::polar(1.0, -2 * pi * k / size);
+        int bits = 0;
+        while ((std::size_t(1) << bits) < size)
+            bits++;
+        for (std::size_t k = 0; k < size; k++) {
+            std::size_t r = 0;
+            for (int b = 0; b < bits; b++)
+                r |= ((k >> b) & 1) << (bits - 1 - b);
+            reversed_[k] = r;
+        }
+    }
+
+    std::size_t size() const { return size_; }
+
+    // in place; the inverse is unscaled
+    void transform(complex* data, bool inverse) const {
+        for (std::size_t k = 0; k < size_; k++)
+            if (k < reversed_[k])
+                std::swap(data[k], data[reversed_[k]]);
+        for (std::size_t half = 1; half < size_; half *= 2) {
+            std::size_t step = size_ / (2 * half);
+            for (std::size_t start = 0; start < size_; start += 2 * half)
+                for (std::size_t k = 0; k < half; k++) {
+                    complex w = twiddle_[k * step];
+                    if (inverse)
+                        w = std::conj(w);
+                    complex odd = mul(w, data[start + k + half]);
+                    data[start + k + half] = data[start + k] - odd;
+                    data[start + k] += odd;
+                }
+        }
+    }
+
+private:
+    std::size_t size_ = 0;
+    std::vector<complex> twiddle_;
+    std::vector<std::size_t> reversed_;
+};
+
+} // namespace structured_detail
+
+
+class ToeplitzMatrix {
+public:
+    ToeplitzMatrix() = default;
+
+    // first column and first row; they must agree on A[0][0]
+    ToeplitzMatrix(const std::vector<double>& column, const std::vector<double>& row)
+        : rows_(column.size()), cols_(row.size()) {
+        if (column.empty() || row.empty() || column[0] != row[0])
+            throw std::invalid_argument("ToeplitzMatrix: first column and row must start with the same element");
+        std::size_t length = 1;
+        while (length < rows_ + cols_ - 1)
+            length *= 2;
+        fft_ = structured_detail::Fft(length);
+
+        // a[k] = t[k] and a[L - k] = t[-k]: circular convolution with a is
+        // the Toeplitz product on the first rows entries
+        spectrum_.assign(length, 0.0);
+        for (std::size_t k = 0; k < rows_; k++)
+            spectrum_[k] = column[k];
+        for (std::size_t k = 1; k < cols_; k++)
+            spectrum_[length - k] = row[k];
+        fft_.transform(spectrum_.data(), false);
+    }
+
+    std::size_t rows() const { return rows_; }
+    std::size_t cols() const { return cols_; }
+    std::size_t fft_size() const { return fft_.size(); }
+
+    void apply(const double* x, double* y) const {
+        using structured_detail::mul;
+        std::vector<structured_detail::complex> buffer(fft_.size(), 0.0);
+        for (std::size_t j = 0; j < cols_; j++)
+            buffer[j] = x[j];
+        fft_.transform(buffer.data(), false);
+        for (std::size_t k = 0; k < buffer.size(); k++)
+            buffer[k] = mul(buffer[k], spectrum_[k]);
+        fft_.transform(buffer.data(), true);
+        const double scale = 1.0 / buffer.size();
+        for (std::size_t i = 0; i < rows_; i++)
+            y[i] = buffer[i].real() * scale;
+    }
+
+private:
+    std::size_t rows_ = 0, cols_ = 0;
+    structured_detail::Fft fft_;
+    std::vector<structured_detail::complex> spectrum_;
+};
+
+class HankelMatrix {
+public:
+    HankelMatrix() = default;
+
+    // h holds the rows + cols - 1 anti-diagonals, A[i][j] = h[i + j]
+    HankelMatrix(const std::vector<double>& h, std::size_t rows, std::size_t cols)
+        : reversed_(toeplitz(h, rows, cols)) {}
+
+    std::size_t rows() const { return reversed_.rows(); }
+    std::size_t cols() const { return reversed_.cols(); }
+    std::size_t fft_size() const { return reversed_.fft_size(); }
+
+    // sum_j h[i + j] x[j] = sum_k t[i - k] x[cols - 1 - k] with t[d] = h[d + cols - 1]
+    void apply(const double* x, double* y) const {
+        std::vector<double> flipped(x, x + cols());
+        std::reverse(flipped.begin(), flipped.end());
+        reversed_.apply(flipped.data(), y);
+    }
+
+private:
+    static ToeplitzMatrix toeplitz(const std::vector<double>& h, std::size_t rows, std::size_t cols) {
+        if (rows == 0 || cols == 0 || h.size() != rows + cols - 1)
+            throw std::invalid_argument("HankelMatrix: need rows + cols - 1 anti-diagonals");
+        std::vector<double> column(h.begin() + cols - 1, h.end());
+        std::vector<double> row(cols);
+        for (std::size_t k = 0; k < cols; k++)
+            row[k] = h[cols - 1 - k];
+        return ToeplitzMatrix(column, row);
+    }
+
+    ToeplitzMatrix reversed_;
+};
+
+class LowRankMatrix {
+public:
+    LowRankMatrix() = default;
+
+    LowRankMatrix(Matrix<double> u, Matrix<double> v) : u_(std::move(u)), v_(std::move(v)) {
+        if (u_.cols() != v_.cols())
+            throw std::invalid_argument("LowRankMatrix: U and V must have the same number of columns");
+    }
+
+    std::size_t rows() const { return u_.rows(); }
+    std::size_t cols() const { return v_.rows(); }
+    std::size_t rank() const { return u_.cols(); }
+
+    // w = V^T x, then y = U w
+    void apply(const double* x, double* y) const {
+        const long r = rank(), n = cols(), m = rows();
+        std::vector<double> w(r, 0.0);
+        double* wp = w.data();
+#pragma omp parallel for reduction(+:wp[:r])
+        for (long j = 0; j < n; j++) {
+            Span<const double> v = v_.row(j);
+            for (long k = 0; k < r; k++)
+                wp[k] += v[k] * x[j];
+        }
+#pragma omp parallel for
+        for (long i = 0; i < m; i++) {
+            Span<const double> u = u_.row(i);
+            double sum = 0.0;
+            for (long k = 0; k < r; k++)
+                sum += u[k] * wp[k];
+            y[i] = sum;
+        }
+    }
+
+    // A * diag(d) = U * (diag(d) * V)^T: only the rows of V are scaled
+    LowRankMatrix scale_columns(const double* d) const {
+        Matrix<double> v(v_.rows(), v_.cols());
+        const long n = cols(), r = rank();
+#pragma omp parallel for schedule(static)
+        for (long j = 0; j < n; j++)
+            for (long k = 0; k < r; k++)
+                v(j, k) = v_(j, k) * d[j];
+        return LowRankMatrix(u_, std::move(v));
+    }
+
+private:
+    Matrix<double> u_, v_;
+};
+
+inline void gemv_parallel(const ToeplitzMatrix& matrix, const double* x, double* y) { matrix.apply(x, y); }
+inline void gemv_parallel(const HankelMatrix& matrix, const double* x, double* y) { matrix.apply(x, y); }
+inline void gemv_parallel(const LowRankMatrix& matrix, const double* x, double* y) { matrix.apply(x, y); }
+
+
+// Detection. An element passes when it is within `tolerance` of the
+// expected value, relative to the larger of its own magnitude and the
+// largest magnitude in the first row and column. Every check stops at the
+// first element that fails, so unstructured matrices are rejected early.
+
+namespace structured_detail {
+
+template <typename M>
+double edge_scale(const M& a) {
+    double scale = 0.0;
+    for (std::size_t j = 0; j < a.cols(); j++)
+        scale = std::max(scale, std::abs(static_cast<double>(a(0, j))));
+    for (std::size_t i = 0; i < a.rows(); i++)
+        scale = std::max(scale, std::abs(static_cast<double>(a(i, 0))));
+    return scale > 0.0 ? scale : 1.0;
+}
+
+inline bool close(double value, double expected, double tolerance, double scale) {
+    return std::abs(value - expected) <= tolerance * std::max(std::abs(value), scale);
+}
+
+// each element equals its upper-left (Toeplitz) or upper-right (Hankel) neighbour
+template <typename M>
+bool has_diagonals(const M& a, bool anti, double tolerance, double scale) {
+    const long m = a.rows(), n = a.cols();
+    for (long i = 1; i < m; i++)
+        for (long j = anti ? 0 : 1; j < (anti ? n - 1 : n); j++)
+            if (!close(a(i, j), a(i - 1, anti ? j + 1 : j - 1), tolerance, scale))
+                return false;
+    return true;
+}
+
+// Adaptive cross approximation with partial pivoting builds a candidate of
+// rank <= max_rank from O(max_rank) rows and columns; one pass over A then
+// verifies it.
+template <typename M>
+bool find_low_rank(const M& a, double tolerance, double scale, int max_rank, LowRankMatrix& out) {
+    const long m = a.rows(), n = a.cols();
+    std::vector<std::vector<double>> us, vs;
+    std::vector<char> used(m, 0);
+    std::vector<double> row(n), col(m);
+    long i = 0;
+    for (int k = 0; k <= max_rank && i >= 0; k++) {
+        for (long j = 0; j < n; j++) {
+            row[j] = a(i, j);
+            for (std::size_t l = 0; l < us.size(); l++)
+                row[j] -= us[l][i] * vs[l][j];
+        }
+        used[i] = 1;
+        long pivot = std::max_element(row.begin(), row.end(), [](double p, double q) {
+            return std::abs(p) < std::abs(q);
+        }) - row.begin();
+        if (std::abs(row[pivot]) <= tolerance * scale)
+            break;
+        if (k == max_rank)
+            return false;
+        for (long r = 0; r < m; r++) {
+            col[r] = a(r, pivot);
+            for (std::size_t l = 0; l < us.size(); l++)
+                col[r] -= vs[l][pivot] * us[l][r];
+        }
+        const double pivot_value = row[pivot];
+        for (long j = 0; j < n; j++)
+            row[j] /= pivot_value;
+        us.push_back(col);
+        vs.push_back(row);
+
+        i = -1;
+        for (long r = 0; r < m; r++)
+            if (!used[r] && (i < 0 || std::abs(col[r]) > std::abs(col[i])))
+                i = r;
+    }
+
+    const long rank = us.size();
+    for (long r = 0; r < m; r++)
+        for (long j = 0; j < n; j++) {
+            double approx = 0.0;
+            for (long l = 0; l < rank; l++)
+                approx += us[l][r] * vs[l][j];
+            if (!close(a(r, j), approx, tolerance, scale))
+                return false;
+        }
+
+    Matrix<double> u(m, rank), v(n, rank);
+    for (long l = 0; l < rank; l++) {
+        for (long r = 0; r < m; r++)
+            u(r, l) = us[l][r];
+        for (long j = 0; j < n; j++)
+            v(j, l) = vs[l][j];
+    }
+    out = LowRankMatrix(std::move(u), std::move(v));
+    return true;
+}
+
+} // namespace structured_detail
+
+
+enum class Structure {
+    Dense,
+    Toeplitz,
+    Hankel,
+    LowRank
+};
+
+inline const char* structure_name(Structure structure) {
+    switch (structure) {
+        case Structure::Toeplitz: return "toeplitz";
+        case Structure::Hankel: return "hankel";
+        case Structure::LowRank: return "low-rank";
+        default: return "dense";
+    }
+}
+
+// Non-owning view of `source` plus the cheapest structured representation
+// found for it. The source must outlive this object.
+template <typename M>
+class StructuredMatrix {
+public:
+    explicit StructuredMatrix(const M& source, double tolerance = 1e-12, int max_rank = 16) : source_(&source) {
+        using namespace structured_detail;
+        const std::size_t m = source.rows(), n = source.cols();
+        const double scale = edge_scale(source);
+        double best = 2.0 * m * n;
+
+        // FFT cost: two transforms of L points plus the pointwise product
+        std::size_t length = 1;
+        while (length < m + n - 1)
+            length *= 2;
+        double fft_cost = 10.0 * length * std::log2(static_cast<double>(length)) + 6.0 * length;
+
+        if (fft_cost < best && has_diagonals(source, false, tolerance, scale)) {
+            std::vector<double> column(m), row(n);
+            for (std::size_t i = 0; i < m; i++)
+                column[i] = source(i, 0);
+            for (std::size_t j = 0; j < n; j++)
+                row[j] = source(0, j);
+            toeplitz_ = ToeplitzMatrix(column, row);
+            structure_ = Structure::Toeplitz;
+            best = fft_cost;
+        } else if (fft_cost < best && has_diagonals(source, true, tolerance, scale)) {
+            std::vector<double> h(m + n - 1);
+            for (std::size_t k = 0; k < n; k++)
+                h[k] = source(0, k);
+            for (std::size_t i = 1; i < m; i++)
+                h[n - 1 + i] = source(i, n - 1);
+            hankel_ = HankelMatrix(h, m, n);
+            structure_ = Structure::Hankel;
+            best = fft_cost;
+        }
+
+        // worth it only if it beats what was found so far
+        int rank_limit = std::min<double>(max_rank, best / (2.0 * (m + n)) - 1);
+        if (rank_limit >= 1 && find_low_rank(source, tolerance, scale, rank_limit, low_rank_))
+            structure_ = Structure::LowRank;
+    }
+
+    // No detection: the dense view of `source`, so the same entry points
+    // also run the source's own kernels.
+    static StructuredMatrix dense(const M& source) { return StructuredMatrix(&source); }
+
+    Structure structure() const { return structure_; }
+    const M& source() const { return *source_; }
+    const ToeplitzMatrix& toeplitz() const { return toeplitz_; }
+    const HankelMatrix& hankel() const { return hankel_; }
+    const LowRankMatrix& low_rank() const { return low_rank_; }
+
+private:
+    explicit StructuredMatrix(const M* source) : source_(source) {}
+
+    const M* source_;
+    Structure structure_ = Structure::Dense;
+    ToeplitzMatrix toeplitz_;
+    HankelMatrix hankel_;
+    LowRankMatrix low_rank_;
+};
+
+template <typename M>
+void gemv_parallel(const StructuredMatrix<M>& matrix, const double* x, double* y) {
+    switch (matrix.structure()) {
+        case Structure::Toeplitz: matrix.toeplitz().apply(x, y); break;
+        case Structure::Hankel: matrix.hankel().apply(x, y); break;
+        case Structure::LowRank: matrix.low_rank().apply(x, y); break;
+        default: gemv_parallel(matrix.source(), x, y); break;
+    }
+}
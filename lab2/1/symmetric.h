@@ -0,0 +1,224 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <omp.h>
+#include "gemv.h"
+
+// Symmetric matrices stored as the packed upper triangle: row i holds
+// A[i][i..n-1] and the rows follow each other without padding, so
+// n(n + 1) / 2 doubles instead of n^2.
+//
+//   SymmetricMatrix a(dense);        // upper triangle of any M with operator()(i, j)
+//   gemv_parallel(a, x, y);          // y = A*x
+//
+// The multiply reads every stored element once and uses it twice: a_ij with
+// j > i adds a_ij * x[j] to y[i] and a_ij * x[i] to y[j]. The second update
+// lands in rows owned by other threads, so each thread accumulates into its
+// own copy of y, padded to whole cache lines, and the copies are summed at
+// the end; a thread whose rows start at r0 only ever writes y[r0..n-1], so
+// only that tail is cleared and summed. That costs O(n * threads) against
+// the n^2 / 2 elements saved. Rows are split so every thread gets the same
+// number of stored elements rather than the same number of rows, and are
+// processed GEMV_ROWS at a time so each load and store of the partial y
+// serves four rows.
+
+namespace symmetric_detail {
+
+using gemv_detail::vec;
+
+// rows [i, i + GEMV_ROWS) of the packed triangle, where row(k)[j] = A[k][j]
+// for j >= k: their dot products with x go to part[i..i + 3], and their
+// column contributions to part[j] for j > i + 3
+__attribute__((target_clones("arch=x86-64-v4", "arch=x86-64-v3", "default")))
+static void symv_block(const double* const* row, long i, long n, const double* x, double* part) {
+    double s[GEMV_ROWS] = {};
+    // the triangle corner, A[i + k][i + k..i + 3]
+    for (int k = 0; k < GEMV_ROWS; k++) {
+        s[k] += row[k][i + k] * x[i + k];
+        for (long j = i + k + 1; j < i + GEMV_ROWS; j++) {
+            s[k] += row[k][j] * x[j];
+            part[j] += row[k][j] * x[i + k];
+        }
+    }
+
+    vec x0 = {}, x1 = {}, x2 = {}, x3 = {};
+    x0 += x[i];
+    x1 += x[i + 1];
+    x2 += x[i + 2];
+    x3 += x[i + 3];
+    vec acc0 = {}, acc1 = {}, acc2 = {}, acc3 = {};
+    vec xv, pv, av;
+    long j = i + GEMV_ROWS;
+    for (; j + GEMV_LANES <= n; j += GEMV_LANES) {
+        std::memcpy(&xv, x + j, sizeof(xv));
+        std::memcpy(&pv, part + j, sizeof(pv));
+        gemv_detail::load(av, row[0] + j);
+        acc0 += av * xv;
+        pv += av * x0;
+        gemv_detail::load(av, row[1] + j);
+        acc1 += av * xv;
+        pv += av * x1;
+        gemv_detail::load(av, row[2] + j);
+        acc2 += av * xv;
+        pv += av * x2;
+        gemv_detail::load(av, row[3] + j);
+        acc3 += av * xv;
+        pv += av * x3;
+        std::memcpy(part + j, &pv, sizeof(pv));
+    }
+    s[0] += gemv_detail::hsum(acc0);
+    s[1] += gemv_detail::hsum(acc1);
+    s[2] += gemv_detail::hsum(acc2);
+    s[3] += gemv_detail::hsum(acc3);
+    for (; j < n; j++)
+        for (int k = 0; k < GEMV_ROWS; k++) {
+            s[k] += row[k][j] * x[j];
+            part[j] += row[k][j] * x[i + k];
+        }
+
+    for (int k = 0; k < GEMV_ROWS; k++)
+        part[i + k] += s[k];
+}
+
+// one row, for the rows left over after the blocks
+__attribute__((target_clones("arch=x86-64-v4", "arch=x86-64-v3", "default")))
+static void symv_row(const double* row, long i, long n, const double* x, double* part) {
+    double s = row[i] * x[i];
+    vec xi = {}, acc = {}, xv, pv, av;
+    xi += x[i];
+    long j = i + 1;
+    for (; j + GEMV_LANES <= n; j += GEMV_LANES) {
+        std::memcpy(&xv, x + j, sizeof(xv));
+        std::memcpy(&pv, part + j, sizeof(pv));
+        gemv_detail::load(av, row + j);
+        acc += av * xv;
+        pv += av * xi;
+        std::memcpy(part + j, &pv, sizeof(pv));
+    }
+    s += gemv_detail::hsum(acc);
+    for (; j < n; j++) {
+        s += row[j] * x[j];
+        part[j] += row[j] * x[i];
+    }
+    part[i] += s;
+}
+
+} // namespace symmetric_detail
+
+
+class SymmetricMatrix {
+public:
+    SymmetricMatrix() = default;
+
+    // zero-filled by the threads that own the rows, so their pages are placed
+    // where those threads run (first touch)
+    explicit SymmetricMatrix(std::size_t n) : n_(n), data_(new double[size()]) {
+#pragma omp parallel
+        {
+            long i0, i1;
+            thread_rows(i0, i1);
+            if (i0 < i1)
+                std::fill(data_.get() + offset(i0), data_.get() + offset(i1), 0.0);
+        }
+    }
+
+    // the upper triangle of `source`; the lower one is not looked at
+    template <typename M, typename = decltype(std::declval<const M&>()(0, 0))>
+    explicit SymmetricMatrix(const M& source) : SymmetricMatrix(source.rows()) {
+#pragma omp parallel
+        {
+            long i0, i1;
+            thread_rows(i0, i1);
+            for (long i = i0; i < i1; i++)
+                for (long j = i; j < static_cast<long>(n_); j++)
+                    row(i)[j] = source(i, j);
+        }
+    }
+
+    SymmetricMatrix(SymmetricMatrix&&) = default;
+    SymmetricMatrix& operator=(SymmetricMatrix&&) = default;
+
+    std::size_t rows() const { return n_; }
+    std::size_t cols() const { return n_; }
+    std::size_t size() const { return n_ * (n_ + 1) / 2; }
+    std::size_t bytes() const { return size() * sizeof(double); }
+
+    double operator()(std::size_t i, std::size_t j) const { return i <= j ? row(i)[j] : row(j)[i]; }
+
+    // row(i)[j] = A[i][j] for j >= i only
+    double* row(std::size_t i) { return data_.get() + offset(i) - i; }
+    const double* row(std::size_t i) const { return data_.get() + offset(i) - i; }
+
+    // y = A*x with the enclosing OpenMP team size
+    void apply(const double* x, double* y) const {
+        const long n = n_;
+        const long stride = (n + GEMV_LANES - 1) / GEMV_LANES * GEMV_LANES;
+        int threads = omp_get_max_threads();
+        std::vector<double> parts(static_cast<std::size_t>(stride) * threads);
+        std::vector<long> first(threads + 1, n);
+#pragma omp parallel num_threads(threads)
+        {
+            const int t = omp_get_thread_num();
+            long i0, i1;
+            thread_rows(i0, i1);
+            first[t] = i0;
+            double* part = parts.data() + t * stride;
+            std::fill(part + i0, part + n, 0.0);
+
+            long i = i0;
+            for (; i + GEMV_ROWS <= i1; i += GEMV_ROWS) {
+                const double* block[GEMV_ROWS] = {row(i), row(i + 1), row(i + 2), row(i + 3)};
+                symmetric_detail::symv_block(block, i, n, x, part);
+            }
+            for (; i < i1; i++)
+                symmetric_detail::symv_row(row(i), i, n, x, part);
+
+#pragma omp barrier
+            // the team may be smaller than asked for; its threads are the
+            // first omp_get_num_threads() slots
+            const int team = omp_get_num_threads();
+#pragma omp for schedule(static)
+            for (long k = 0; k < n; k++) {
+                double sum = 0.0;
+                for (int u = 0; u < team && first[u] <= k; u++)
+                    sum += parts[u * stride + k];
+                y[k] = sum;
+            }
+        }
+    }
+
+private:
+    // start of row i in the packed array
+    std::size_t offset(std::size_t i) const { return i * n_ - i * (i - 1) / 2; }
+
+    // Rows of this thread: a contiguous block holding about 1 / threads of
+    // the stored elements; block starts are rounded to GEMV_ROWS.
+    void thread_rows(long& i0, long& i1) const {
+        const long threads = omp_get_num_threads(), t = omp_get_thread_num();
+        i0 = t == 0 ? 0 : first_row(static_cast<double>(size()) * t / threads);
+        i1 = t + 1 == threads ? static_cast<long>(n_) : first_row(static_cast<double>(size()) * (t + 1) / threads);
+    }
+
+    // the first row, a multiple of GEMV_ROWS, starting at or after `elements`
+    long first_row(double elements) const {
+        long lo = 0, hi = (n_ + GEMV_ROWS - 1) / GEMV_ROWS;
+        while (lo < hi) {
+            long mid = (lo + hi) / 2;
+            if (offset(std::min<std::size_t>(n_, mid * GEMV_ROWS)) < elements)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        return std::min<long>(n_, lo * GEMV_ROWS);
+    }
+
+    std::size_t n_ = 0;
+    std::unique_ptr<double[]> data_;
+};
+
+inline void gemv_parallel(const SymmetricMatrix& matrix, const double* x, double* y) { matrix.apply(x, y); }
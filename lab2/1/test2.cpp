@@ -1,9 +1,17 @@
 #include <iostream>
 #include <iomanip>
+#include <cstdio>
+#include <stdexcept>
 #include <vector>
 #include <thread>
-#include <chrono>
 #include <omp.h>
+#include "matrix.h"
+#include "gemv.h"
+#include "out_of_core.h"
+#include "structured.h"
+#include "bench.h"
+#include "perf_counters.h"
+#include "roofline.h"
 
 
 std::string executeCommand(const std::string& command) {
@@ -20,32 +28,38 @@ std::string executeCommand(const std::string& command) {
 }
 
 
-std::vector<double> matrixVectorMult(const std::vector<std::vector<double>>& matrix, const std::vector<double>& vector, int n) {
+// A structured matrix goes to its fast path (with a team of one thread),
+// a dense one to the serial row kernel.
+std::vector<double> matrixVectorMult(const StructuredMatrix<Matrix<double>>& matrix, const std::vector<double>& vector, int n) {
 
     std::vector<double> result(n, 0.0);
 
-    for (int i = 0; i < n; i++)
-        for (int j = 0; j < n; j++)
-            result[i] += matrix[i][j] * vector[j];
+    if (matrix.structure() == Structure::Dense)
+        gemv_rows(matrix.source(), vector.data(), result.data(), 0, n);
+    else
+        gemv_parallel(matrix, vector.data(), result.data());
     return result;
 }
 
 
-std::vector<double> multi_matrixVectorMult(const std::vector<std::vector<double>>& matrix, const std::vector<double>& vector, int numThreads, int n) {
+std::vector<double> multi_matrixVectorMult(const StructuredMatrix<Matrix<double>>& matrix, const std::vector<double>& vector, int numThreads, int n) {
 
     std::vector<double> result(n, 0.0);
 
     omp_set_num_threads(numThreads);
 
-#pragma omp parallel for
-    for (int i = 0; i < n; i++)
-        for (int j = 0; j < n; j++)
-            result[i] += matrix[i][j] * vector[j];
+    gemv_parallel(matrix, vector.data(), result.data());
     return result;
 }
 
 
-int main() {
+// usage: test2 [dir]
+// Sizes too large for memory are streamed from dir/matrix_<n>.bin, which is
+// reused on later runs; without dir the file is written to the current
+// directory and removed after its sweep.
+int main(int argc, char** argv) {
+    std::string keep_dir = argc > 1 ? argv[1] : "";
+
     std::string cpuInfo = executeCommand("lscpu");
     std::string serverName = executeCommand("cat /sys/devices/virtual/dmi/id/product_name");
     std::string numaInfo = executeCommand("numactl --hardware");
@@ -60,61 +74,74 @@ int main() {
 
     std::vector<int> sizes = {20000, 400000};
     std::vector<int> threads = {1, 2, 4, 7, 8, 16, 20, 40};
-    std::vector<std::vector<std::pair<long long, double>>> table;
-    table.resize(sizes.size(), std::vector<std::pair<long long, double>>(threads.size()));
-
-    long long T = 0.0;
-    double S = 0.0;
-
-    for (int i = 0; i < sizes.size(); ++i)
-        for (int j = 0; j < sizes.size(); ++j) {
-            int n = sizes[i];
-            int numThreads = threads[j];
-
-            std::vector<std::vector<double>> matrix(n, std::vector<double>(n, 1.0));
-            std::vector<double> vector(n, 2.0);
-
-            auto startTime = std::chrono::high_resolution_clock::now();
-
-            std::vector<double> result;
-
-            result = matrixVectorMult(matrix, vector, n);
-
-            auto endTime = std::chrono::high_resolution_clock::now();
-            auto duration = std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime);
-
-            T = duration.count();
-
-            startTime = std::chrono::high_resolution_clock::now();
-
-            result = multi_matrixVectorMult(matrix, vector, numThreads, n);
-
-            endTime = std::chrono::high_resolution_clock::now();
-            duration = std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime);
-
-            S = static_cast<double>(T) / static_cast<double>(duration.count());
-
-//            std::cout << "Result: ";
-//            for (double val : result) {
-//                std::cout << val << " ";
-//            }
-//            std::cout << std::endl;
-
-            table[i][j] = std::make_pair(T, S);
-
-            std::cout << T << " " << S << std::endl;
 
+    Sweep sweep("lab2/1 gemv");
+
+    for (int i = 0; i < sizes.size(); ++i) {
+        int n = sizes[i];
+
+        std::vector<double> vector(n, 2.0);
+        std::vector<double> result;
+        // one multiply-add per element; the matrix is read once, x and y are small
+        sweep.annotate(2.0 * n * n, 8.0 * n * n + 16.0 * n);
+
+        // too large for memory: stream it from a file instead
+        if (8.0 * n * n >= MEMORY_FRACTION * available_memory()) {
+            std::string path = (keep_dir.empty() ? "" : keep_dir + "/") + "matrix_" + std::to_string(n) + ".bin";
+            if (!matrix_file_matches(path, n, n)) {
+                std::cout << "Writing " << path << " (" << 8.0 * n * n / 1e9 << " GB)" << std::endl;
+                try {
+                    write_matrix_file(path, n, n, [](long, long) { return 1.0; });
+                } catch (const std::runtime_error& e) {
+                    // n = 400000 is 1.28 TB; without the disk for it the size is left out
+                    std::cout << "Skipping n = " << n << ": " << e.what() << std::endl;
+                    continue;
+                }
+            }
+            {
+                OutOfCoreGemv matrix(path);
+                result.assign(n, 0.0);
+                for (int j = 0; j < threads.size(); ++j) {
+                    int numThreads = threads[j];
+                    omp_set_num_threads(numThreads);
+                    sweep.run(std::string("gemv ") + mode_name(matrix.mode()), n, numThreads, [&] {
+                        matrix.multiply(vector.data(), result.data());
+                    }, "", TeamCounters(numThreads));
+                }
+            }
+            if (keep_dir.empty())
+                std::remove(path.c_str());
+            continue;
         }
 
-    std::cout << "| Size   | Threads | Time (nanoseconds) | Speedup |\n";
-    std::cout << "|--------|---------|--------------------|---------|\n";
-    for (int i = 0; i < sizes.size(); ++i)
-        for (int j = 0; j < threads.size(); ++j) {
-            std::cout << "| " << sizes[i] << "    | " << threads[j] << "       | ";
-            std::cout << table[i][j].first << "                    | ";
-            std::cout << table[i][j].second << "       |\n";
+        Matrix<double> matrix(n, n, 1.0);
+        auto run_threads = [&](const StructuredMatrix<Matrix<double>>& form, const std::string& kernel) {
+            // one thread is the serial kernel, the baseline of the speedups
+            for (int j = 0; j < threads.size(); ++j) {
+                int numThreads = threads[j];
+                omp_set_num_threads(numThreads);
+                sweep.run(kernel, n, numThreads, [&] {
+                    result = numThreads == 1 ? matrixVectorMult(form, vector, n)
+                                             : multi_matrixVectorMult(form, vector, numThreads, n);
+                }, "", TeamCounters(numThreads));
+            }
+        };
+
+        // the dense kernels always; then the fast path, if detection (done
+        // once) finds a structure
+        run_threads(StructuredMatrix<Matrix<double>>::dense(matrix), "gemv");
+        StructuredMatrix<Matrix<double>> structured(matrix);
+        if (structured.structure() != Structure::Dense) {
+            // the dense flop and byte counts do not describe the fast path
+            sweep.annotate(0.0, 0.0);
+            run_threads(structured, std::string("gemv ") + structure_name(structured.structure()));
         }
+    }
+
+    sweep.print_summary();
+    sweep.save();
+    if (roofline_mode())
+        print_roofline(sweep.records());
 
     return 0;
 }
-
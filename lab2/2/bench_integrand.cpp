@@ -0,0 +1,69 @@
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <omp.h>
+#include "quadrature.h"
+#include "simd_math.h"
+#include "bench.h"
+
+
+struct Pi4 {
+    double operator()(double x) const { return 4.0 / (1.0 + x * x); }
+    void operator()(vdouble& y, const vdouble& x) const { y = 4.0 / (1.0 + x * x); }
+};
+
+struct Sin {
+    double operator()(double x) const { return std::sin(x); }
+    void operator()(vdouble& y, const vdouble& x) const { vsin(y, x); }
+};
+
+
+// the loop integrate_omp had: one scalar sum, one evaluation at a time
+template <typename F>
+double scalar_loop(F f, long nsteps) {
+    double sum = 0.0;
+    double step = 1.0 / nsteps;
+
+#pragma omp parallel for reduction(+:sum)
+    for (long i = 0; i < nsteps; i++) {
+        double x = (i + 0.5) * step;
+        sum += f(x);
+    }
+
+    return sum * step;
+}
+
+// evaluations per second per core, against the scalar loop
+template <typename F>
+void run(const std::string& title, F f, double exact, long nsteps) {
+    const int cores = std::min(omp_get_max_threads(), omp_get_num_procs());
+    double result = 0.0;
+    std::cout << title << ":" << std::endl;
+
+    double base = measure([&] { result = scalar_loop(f, nsteps); }).median;
+    std::cout << "  scalar loop     " << nsteps / base / cores / 1e9 << " G evaluations/s/core, error "
+              << std::fabs(result - exact) << std::endl;
+
+    double simd = measure([&] { result = integrate<Midpoint>(f, 0.0, 1.0, nsteps); }).median;
+    std::cout << "  omp simd        " << nsteps / simd / cores / 1e9 << " G evaluations/s/core, error "
+              << std::fabs(result - exact) << ", speedup " << base / simd << std::endl;
+
+    double vector = measure([&] { result = integrate_simd<Midpoint>(f, 0.0, 1.0, nsteps); }).median;
+    std::cout << "  vector lanes    " << nsteps / vector / cores / 1e9 << " G evaluations/s/core, error "
+              << std::fabs(result - exact) << ", speedup " << base / vector << std::endl;
+}
+
+
+// usage: bench_integrand [nsteps]
+int main(int argc, char** argv) {
+    long nsteps = argc > 1 ? std::atol(argv[1]) : 40000000;
+
+    std::cout << "Threads: " << omp_get_max_threads() << ", nsteps = " << nsteps << std::endl << std::endl;
+
+    run("4 / (1 + x^2)", Pi4(), std::acos(-1.0), nsteps);
+    run("sin(x)", Sin(), 1.0 - std::cos(1.0), nsteps);
+
+    return 0;
+}
@@ -1,62 +1,62 @@
 #include <iostream>
+#include <cmath>
 #include <omp.h>
 #include <vector>
-#include <chrono>
+#include "affinity.h"
+#include "bench.h"
+#include "perf_counters.h"
+#include "roofline.h"
+#include "quadrature.h"
 
 
-// 4.0 / (1.0 + x^2) [0;1]
-double integrate_omp(int nsteps) {
-    double sum = 0.0;
-    double step = 1.0 / nsteps;
-
-#pragma omp parallel for reduction(+:sum)
-    for (int i = 0; i < nsteps; i++) {
-        double x = (i + 0.5) * step;
-        double fx = 4.0 / (1.0 + x * x);
-        sum += fx;
-    }
-
-    return sum * step;
-}
+// 4.0 / (1.0 + x^2) [0;1], integrates to pi
+struct Pi4 {
+    double operator()(double x) const { return 4.0 / (1.0 + x * x); }
+    void operator()(vdouble& y, const vdouble& x) const { y = 4.0 / (1.0 + x * x); }
+};
 
 
 int main() {
     int nsteps = 40000000;
     
     std::vector<int> num_threads = {1, 2, 4, 7, 8, 16, 20, 40};
-    std::vector<double> speedup(num_threads.size());
-    std::vector<double> runtimes(num_threads.size());
-
-    double serial_time, parallel_time;
 
-    auto start_time = std::chrono::high_resolution_clock::now();
-    double result_serial = integrate_omp(nsteps);
-    auto end_time = std::chrono::high_resolution_clock::now();
-    serial_time = std::chrono::duration<double>(end_time - start_time).count();
-
-    std::cout << "Time: " << serial_time << " sec" << std::endl << std::endl;
+    Affinity affinity = affinity_from_env();
+    std::cout << "Affinity: " << affinity_name(affinity) << " (" << omp_environment(affinity, omp_get_num_procs()) << ")" << std::endl;
+
+    const double pi = std::acos(-1.0);
+    std::cout << "Evaluations to within 1e-12 of pi:" << std::endl;
+    print_convergence<Midpoint>(Pi4(), 0.0, 1.0, pi, 1e-12);
+    print_convergence<Trapezoid>(Pi4(), 0.0, 1.0, pi, 1e-12);
+    print_convergence<Simpson>(Pi4(), 0.0, 1.0, pi, 1e-12);
+    print_convergence<GaussLegendre<3>>(Pi4(), 0.0, 1.0, pi, 1e-12);
+    print_convergence<GaussLegendre<5>>(Pi4(), 0.0, 1.0, pi, 1e-12);
+    std::cout << "Adaptive Gauss-Kronrod, absolute and relative tolerance:" << std::endl;
+    print_adaptive(Pi4(), 0.0, 1.0, pi, {1e-6, 1e-10, 1e-14});
+    std::cout << std::endl;
+
+    Sweep sweep("lab2/2 integrate");
+    // per step: x (2), 1 + x * x (2), the division and the sum; no memory traffic
+    sweep.annotate(6.0 * nsteps, 0.0);
+    double result = 0.0;
 
     for (int i = 0; i < num_threads.size(); i++) {
         int num_thread = num_threads[i];
 
         omp_set_num_threads(num_thread);
+        bind_omp_threads(affinity, num_thread);
 
-        start_time = std::chrono::high_resolution_clock::now();
-        double result_parallel = integrate_omp(nsteps);
-        end_time = std::chrono::high_resolution_clock::now();
-        parallel_time = std::chrono::duration<double>(end_time - start_time).count();
-
-        runtimes[i] = parallel_time;
-        double speed = serial_time / parallel_time;
-        speedup[i] = speed;
-
-        std::cout << "Time with " << num_thread << " threads: " << parallel_time << " seconds" << std::endl;
-        std::cout << "S with " << num_thread << " threads: " << speed << std::endl << std::endl;
+        sweep.run("integrate", nsteps, num_thread, [&] { result = integrate<Midpoint>(Pi4(), 0.0, 1.0, nsteps); }, omp_placement(num_thread),
+                  TeamCounters(num_thread));
+        sweep.run("integrate simd", nsteps, num_thread, [&] { result = integrate_simd<Midpoint>(Pi4(), 0.0, 1.0, nsteps); },
+                  omp_placement(num_thread), TeamCounters(num_thread));
     }
 
-    std::cout << "\nSummary:\n";
-    for (int i = 0; i < num_threads.size(); i++)
-        std::cout << num_threads[i] << " threads: S = " << speedup[i] << ", T = " << runtimes[i] << std::endl;
+    std::cout << "Result: " << result << std::endl;
+    sweep.print_summary();
+    sweep.save();
+    if (roofline_mode())
+        print_roofline(sweep.records());
 
     return 0;
 }
\ No newline at end of file
@@ -1,70 +1,65 @@
 #include <iostream>
 #include <cmath>
 #include <omp.h>
-#include <chrono>
 #include <vector>
+#include "affinity.h"
+#include "bench.h"
+#include "perf_counters.h"
+#include "roofline.h"
+#include "quadrature.h"
 
 
-double f(double x) {
-    return std::sin(x);
-}
+// rough cost of std::sin in flops: range reduction and a degree ~13
+// polynomial, for the roofline only
+const double SIN_FLOPS = 20.0;
 
-
-double integrate_omp(int num_threads, int nsteps) {
-    double result = 0.0;
-    double step = 1.0 / nsteps;
-
-#pragma omp parallel for num_threads(num_threads) reduction(+:result)
-    for (int i = 0; i < nsteps; i++) {
-        double x = (i + 0.5) * step;
-        result += f(x);
-    }
-
-    result *= step;
-
-    return result;
-}
+// sin(x) [0;1], integrates to 1 - cos(1)
+struct Sin {
+    double operator()(double x) const { return std::sin(x); }
+    void operator()(vdouble& y, const vdouble& x) const { vsin(y, x); }
+};
 
 
 int main() {
     int nsteps = 40000000;
     std::vector<int> num_threads = {1, 2, 4, 7, 8, 16, 20, 40};
-    std::vector<double> runtimes(num_threads.size());
-    std::vector<double> speedups(num_threads.size());
 
-    double sequential_runtime;
-    double sequential_result;
-
-    {
-        auto start_time = std::chrono::high_resolution_clock::now();
-        sequential_result = integrate_omp(1, nsteps);
-        auto end_time = std::chrono::high_resolution_clock::now();
-        sequential_runtime = std::chrono::duration<double>(end_time - start_time).count();
-    }
-
-    std::cout << "Sequential result: " << sequential_result << std::endl;
-    std::cout << "Sequential runtime: " << sequential_runtime << " seconds" << std::endl;
+    Affinity affinity = affinity_from_env();
+    std::cout << "Affinity: " << affinity_name(affinity) << " (" << omp_environment(affinity, omp_get_num_procs()) << ")" << std::endl;
+
+    const double exact = 1.0 - std::cos(1.0);
+    std::cout << "Evaluations to within 1e-12 of 1 - cos(1):" << std::endl;
+    print_convergence<Midpoint>(Sin(), 0.0, 1.0, exact, 1e-12);
+    print_convergence<Trapezoid>(Sin(), 0.0, 1.0, exact, 1e-12);
+    print_convergence<Simpson>(Sin(), 0.0, 1.0, exact, 1e-12);
+    print_convergence<GaussLegendre<3>>(Sin(), 0.0, 1.0, exact, 1e-12);
+    print_convergence<GaussLegendre<5>>(Sin(), 0.0, 1.0, exact, 1e-12);
+    std::cout << "Adaptive Gauss-Kronrod, absolute and relative tolerance:" << std::endl;
+    print_adaptive(Sin(), 0.0, 1.0, exact, {1e-6, 1e-10, 1e-14});
+    std::cout << std::endl;
+
+    Sweep sweep("lab2/3 integrate");
+    // per step: x (2) and the sum, plus SIN_FLOPS for the sin call
+    sweep.annotate((3.0 + SIN_FLOPS) * nsteps, 0.0);
+    double result = 0.0;
 
     for (int i = 0; i < num_threads.size(); i++) {
         int num_thread = num_threads[i];
 
         omp_set_num_threads(num_thread);
+        bind_omp_threads(affinity, num_thread);
 
-        auto start_time = std::chrono::high_resolution_clock::now();
-        double parallel_result = integrate_omp(num_thread, nsteps);
-        auto end_time = std::chrono::high_resolution_clock::now();
-        double parallel_runtime = std::chrono::duration<double>(end_time - start_time).count();
-
-        runtimes[i] = parallel_runtime;
-        speedups[i] = sequential_runtime / parallel_runtime;
-
-        std::cout << "Runtime with " << num_thread << " threads: " << parallel_runtime << " sec" << std::endl;
-        std::cout << "Speedup with " << num_thread << " threads: " << speedups[i] << std::endl << std::endl;
+        sweep.run("integrate", nsteps, num_thread, [&] { result = integrate<Midpoint>(Sin(), 0.0, 1.0, nsteps); }, omp_placement(num_thread),
+                  TeamCounters(num_thread));
+        sweep.run("integrate simd", nsteps, num_thread, [&] { result = integrate_simd<Midpoint>(Sin(), 0.0, 1.0, nsteps); },
+                  omp_placement(num_thread), TeamCounters(num_thread));
     }
 
-    std::cout << "Summary:" << std::endl;
-    for (int i = 0; i < num_threads.size(); i++)
-        std::cout << num_threads[i] << " threads: S = " << speedups[i] << ", T = " << runtimes[i] << std::endl;
+    std::cout << "Result: " << result << std::endl;
+    sweep.print_summary();
+    sweep.save();
+    if (roofline_mode())
+        print_roofline(sweep.records());
 
     return 0;
 }
\ No newline at end of file
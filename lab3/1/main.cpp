@@ -1,14 +1,18 @@
 #include <iostream>
 #include <vector>
 #include <thread>
-#include <chrono>
 #include <numeric>
+#include "matrix.h"
+#include "affinity.h"
+#include "bench.h"
+#include "perf_counters.h"
 
-void matrixVectorMultiplication(const std::vector<std::vector<int>>& matrix, const std::vector<int>& vector, std::vector<int>& result, int start, int end) {
+void matrixVectorMultiplication(const Matrix<int>& matrix, const std::vector<int>& vector, std::vector<int>& result, int start, int end) {
     for (int i = start; i < end; ++i) {
+        Span<const int> row = matrix.row(i);
         result[i] = 0;
-        for (int j = 0; j < matrix[i].size(); ++j) {
-            result[i] += matrix[i][j] * vector[j];
+        for (int j = 0; j < row.size(); ++j) {
+            result[i] += row[j] * vector[j];
         }
     }
 }
@@ -19,12 +23,23 @@ void parallelArrayInit(std::vector<int>& array, int start, int end) {
     }
 }
 
+// first touch: each thread fills the rows it multiplies later
+void parallelMatrixInit(Matrix<int>& matrix, int start, int end) {
+    for (int i = start; i < end; ++i) {
+        Span<int> row = matrix.row(i);
+        for (int j = 0; j < row.size(); ++j)
+            row[j] = 1;
+    }
+}
+
 int main() {
     std::vector<int> sizes = {20000, 40000};
     std::vector<int> num_threads = {1, 2, 4, 7, 8, 16, 20, 40};
 
-    std::vector<std::vector<double>> runtimes(num_threads.size(), std::vector<double>(sizes.size()));
-    std::vector<std::vector<double>> speedups(num_threads.size(), std::vector<double>(sizes.size()));
+    Affinity affinity = affinity_from_env();
+    std::cout << "Affinity: " << affinity_name(affinity) << std::endl << std::endl;
+
+    Sweep sweep("lab3/1 matvec");
 
     for (int i = 0; i < num_threads.size(); i++) {
         int numThreads = num_threads[i];
@@ -32,48 +47,59 @@ int main() {
 
             int matrixSize = sizes[j];
 
-            std::vector<std::vector<int>> matrix(matrixSize, std::vector<int>(matrixSize, 1));
+            Matrix<int> matrix(matrixSize, matrixSize);
             std::vector<int> vector(matrixSize, 2);
             std::vector<int> result(matrixSize);
 
 
             std::vector<std::thread> threads;
             int chunkSize = matrixSize / numThreads;
+            // the last thread also takes the remainder rows
+            auto chunkEnd = [&](int k) { return k == numThreads - 1 ? matrixSize : (k + 1) * chunkSize; };
+            // each worker pins itself before touching memory, so init and
+            // compute of block k run on the same CPUs
+            std::vector<std::vector<int>> cpuSets = placement(affinity, numThreads);
+            std::vector<int> ranOn(numThreads);
 
             for (int k = 0; k < numThreads; ++k)
-                threads.emplace_back(parallelArrayInit, std::ref(vector), k * chunkSize, (k + 1) * chunkSize);
+                threads.emplace_back([&, k] {
+                    pin_this_thread(cpuSets[k]);
+                    parallelMatrixInit(matrix, k * chunkSize, chunkEnd(k));
+                    parallelArrayInit(vector, k * chunkSize, chunkEnd(k));
+                });
 
             for (auto& thread : threads)
                 thread.join();
 
 
-            auto start_time = std::chrono::high_resolution_clock::now();
-
-            for (int k = 0; k < numThreads; ++k)
-                threads[k] = std::thread(matrixVectorMultiplication, std::ref(matrix), std::ref(vector), std::ref(result), k * chunkSize, (k + 1) * chunkSize);
-
-            for (auto& thread : threads)
-                thread.join();
-
-            auto end_time = std::chrono::high_resolution_clock::now();
-
-            double runtime = std::chrono::duration<double>(end_time - start_time).count();
-
-            runtimes[i][j] = runtime;
-
-            double speedup;
-            j == 1 ? speedup = runtimes[0][1] / runtime : speedup = runtimes[0][0] / runtime;
-            speedups[i][j] = speedup;
-
-            std::cout << "Runtime with " << numThreads << " threads and matrix size " << matrixSize << ": " << runtime << " seconds" << std::endl;
-            std::cout << "Speedup with " << numThreads << " threads and matrix size " << matrixSize << ": " << speedup << std::endl << std::endl;
+            BenchRecord record;
+            record.kernel = "matvec";
+            record.size = matrixSize;
+            record.threads = numThreads;
+            // the workers are new threads every run, count them through the
+            // main thread's inherited counters
+            ThreadCounters counters(true);
+            record.stats = measure([&] {
+                for (int k = 0; k < numThreads; ++k)
+                    threads[k] = std::thread([&, k] {
+                        pin_this_thread(cpuSets[k]);
+                        ranOn[k] = sched_getcpu();
+                        matrixVectorMultiplication(matrix, vector, result, k * chunkSize, chunkEnd(k));
+                    });
+
+                for (auto& thread : threads)
+                    thread.join();
+            }, sweep.options(), counters);
+            record.metrics = counters.metrics(record.stats.runs);
+
+            for (int cpu : ranOn)
+                record.placement += (record.placement.empty() ? "" : " ") + std::to_string(cpu);
+            sweep.add(record);
         }
     }
 
-    std::cout << "Summary:" << std::endl;
-    for (int i = 0; i < num_threads.size(); i++)
-        for (int j = 0; j < sizes.size(); j++)
-            std::cout << num_threads[i] << " threads and matrix size " << sizes[j] << ": S = " << speedups[i][j] << ", T = " << runtimes[i][j] << std::endl;
+    sweep.print_summary();
+    sweep.save();
 
     return 0;
 }
\ No newline at end of file